@@ -5,13 +5,23 @@
 #include "platform.h"
 #include "platformdefs.h"
 
+#define BX_RTC_CMD 0
+#define BX_RTC_DATA 1
+
+#define BX_RTC_GET_TIME 2
+#define BX_RTC_GET_TIME_MS 3
+
 struct FwDeviceDatabase *BxDeviceDatabase;
 struct FwApiTable *BxApiTable;
 struct FwPartition *BxBootDisk;
 size_t BxNumCpus;
 
-void BxPrintCharacter(unsigned char c) {
-    BxApiTable->PutCharacter(c);
+void BxPrintString(const char *str) {
+    BxApiTable->PutString(str);
+}
+
+uint32_t BxBootDiskIndex(void) {
+    return BxBootDisk->Id;
 }
 
 bool BxReadFromDisk(void *buffer, uint64_t sector, size_t count) {
@@ -24,6 +34,26 @@ bool BxReadFromDisk(void *buffer, uint64_t sector, size_t count) {
     return BxApiTable->ReadDisk(BxBootDisk, buffer, sector, end - sector);
 }
 
+static uint32_t BxRtcCommand(uint32_t command) {
+    volatile uint32_t *regs = (volatile uint32_t *)BX_RTC_BASE;
+    regs[BX_RTC_CMD] = command;
+    return regs[BX_RTC_DATA];
+}
+
+uint64_t BxGetTimeMs(void) {
+    uint32_t seconds, milliseconds;
+
+    // the seconds and milliseconds are latched separately, so retry if the seconds rolled over in between
+    do {
+        seconds = BxRtcCommand(BX_RTC_GET_TIME);
+        milliseconds = BxRtcCommand(BX_RTC_GET_TIME_MS);
+    } while (BxRtcCommand(BX_RTC_GET_TIME) != seconds);
+
+    // seconds * 1000, without needing a 64-bit multiply from libgcc
+    uint64_t time = seconds;
+    return (time << 10) - (time << 4) - (time << 3) + milliseconds;
+}
+
 struct BxKickProcessorData {
     void (*func)(void *);
     void *ctx;
@@ -36,19 +66,7 @@ static void BxKickProcessorHandler(size_t, void *ptr) {
     void (*func)(void *) = data->func;
     void *ctx = data->ctx;
 
-    // This is just an atomic add with release semantics, but that isn't implemented in GCC currently,
-    // so do it via ASM.
-
-    size_t scratch;
-    asm volatile("wmb\n"
-                 "1:\n"
-                 "ll\t%0,%1\n"
-                 "addi\t%0,%0,1\n"
-                 "sc\t%0,%1,%0\n"
-                 "beq\t%0,1b"
-                 : "=&r"(scratch)
-                 : "r"(&data->numFinished)
-                 : "memory");
+    BlAtomicFetchAdd(&data->numFinished, 1);
 
     func(ctx);
 }
@@ -69,6 +87,6 @@ void BxRunOnOtherCpus(void (*func)(void *), void *ctx) {
     }
 
     while (__atomic_load_n(&data.numFinished, __ATOMIC_ACQUIRE) < respondCount) {
-        asm("pause");
+        BlSpinPause();
     }
 }
@@ -89,6 +89,10 @@ struct FwApiTable {
     void (*KickProcessor)(size_t number, void *context, void (*callback)(size_t number, void *context));
 };
 
+#define BX_RTC_BASE 0xf800'0080
+#define BX_RTC_SIZE 8
+#define BX_RTC_IRQ 2
+
 extern struct FwDeviceDatabase *BxDeviceDatabase;
 extern struct FwApiTable *BxApiTable;
 extern struct FwPartition *BxBootDisk;
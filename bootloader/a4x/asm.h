@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+
+static inline size_t BlReadWhami(void) {
+    size_t value;
+    asm volatile("mfcr %0, whami" : "=r"(value));
+    return value;
+}
+
+// Atomically adds value to *ptr with acquire and release semantics, and returns the old value. GCC doesn't implement
+// atomic read-modify-write operations for this architecture, so do it via ASM.
+static inline size_t BlAtomicFetchAdd(size_t *ptr, size_t value) {
+    size_t old;
+    size_t scratch;
+    asm volatile("mb\n"
+                 "1:\n"
+                 "ll\t%0,%2\n"
+                 "add\t%1,%0,%3\n"
+                 "sc\t%1,%2,%1\n"
+                 "beq\t%1,1b\n"
+                 "mb"
+                 : "=&r"(old), "=&r"(scratch)
+                 : "r"(ptr), "r"(value)
+                 : "memory");
+    return old;
+}
+
+static inline void BlSpinPause(void) {
+    asm volatile("pause");
+}
@@ -15,10 +15,6 @@
 #define BX_LSIC_BASE 0xf803'0000
 #define BX_LSIC_SIZE 0x100
 
-#define BX_RTC_BASE 0xf800'0080
-#define BX_RTC_SIZE 8
-#define BX_RTC_IRQ 2
-
 #define BX_SERIAL_COUNT 2
 #define BX_SERIAL_SIZE 8
 #define BX_SERIAL_BASE(n) (0xf800'0040 + (n) * BX_SERIAL_SIZE)
@@ -58,18 +54,7 @@ static void BxAddMemoryRanges(void) {
     }
 }
 
-static void BxDtAddMemoryBank(size_t start, size_t end) {
-    char buffer[32];
-    BlPrintToBuffer(buffer, BL_ARRAY_SIZE(buffer), "memory@%zx", start);
-
-    auto node = BlDtCreateNode(nullptr, buffer);
-    uint32_t reg[] = {start, end - start};
-
-    BlDtAddPropertyString(node, "device_type", "memory");
-    BlDtAddPropertyU32s(node, "reg", reg, BL_ARRAY_SIZE(reg));
-}
-
-static void BxDtAddMemory(void) {
+void BxForEachMemoryRange(void (*func)(uintptr_t base, size_t size, void *ctx), void *ctx) {
     size_t start = 0;
     size_t end = 0;
 
@@ -80,14 +65,25 @@ static void BxDtAddMemory(void) {
         size_t base = i * BX_RAM_BANK_INTERVAL;
 
         if (base != end) {
-            if (start != end) BxDtAddMemoryBank(start, end);
+            if (start != end) func(start, end - start, ctx);
             start = base;
         }
 
         end = base + pages * 0x1000;
     }
 
-    if (start != end) BxDtAddMemoryBank(start, end);
+    if (start != end) func(start, end - start, ctx);
+}
+
+static void BxDtAddMemoryBank(uintptr_t base, size_t size, void *) {
+    char buffer[32];
+    BlPrintToBuffer(buffer, BL_ARRAY_SIZE(buffer), "memory@%zx", base);
+
+    auto node = BlDtCreateNode(nullptr, buffer);
+    uint32_t reg[] = {base, size};
+
+    BlDtAddPropertyString(node, "device_type", "memory");
+    BlDtAddPropertyU32s(node, "reg", reg, BL_ARRAY_SIZE(reg));
 }
 
 static uint32_t BxCpuPhandles[BL_ARRAY_SIZE(((struct FwDeviceDatabase *)0)->Processors)];
@@ -236,6 +232,31 @@ static void BxDtAddBoards(void) {
     }
 }
 
+// lets the kernel draw on the screen long before the kinnow driver is loaded
+static void BxDtAddFramebuffer(void) {
+    struct FwFramebuffer *fb = &BxDeviceDatabase->Framebuffer;
+    if (fb->Type != FW_FRAMEBUFFER_KINNOWFB) return;
+
+    auto chosen = BlDtFindOrCreateNode(nullptr, "chosen");
+    BlDtAddPropertyU32(chosen, "#address-cells", 1);
+    BlDtAddPropertyU32(chosen, "#size-cells", 1);
+    BlDtAddProperty(chosen, "ranges", nullptr, 0);
+
+    char buffer[32];
+    BlPrintToBuffer(buffer, sizeof(buffer), "framebuffer@%zx", (uintptr_t)fb->Address);
+
+    // the kinnow uses one palette index per pixel, with lines packed back to back
+    auto node = BlDtCreateNode(chosen, buffer);
+    uint32_t reg[] = {(uintptr_t)fb->Address, (uint32_t)fb->Width * fb->Height};
+
+    BlDtAddPropertyString(node, "compatible", "simple-framebuffer");
+    BlDtAddPropertyU32s(node, "reg", reg, BL_ARRAY_SIZE(reg));
+    BlDtAddPropertyU32(node, "width", fb->Width);
+    BlDtAddPropertyU32(node, "height", fb->Height);
+    BlDtAddPropertyU32(node, "stride", fb->Width);
+    BlDtAddPropertyString(node, "format", "c8");
+}
+
 static void BxDtCreateSocNode(void) {
     BxSocNode = BlDtCreateNode(nullptr, "soc");
     BlDtAddPropertyU32(BxSocNode, "#address-cells", 1);
@@ -260,7 +281,7 @@ static void BxDtPopulate() {
 
     BxAliasesNode = BlDtCreateNode(nullptr, "aliases");
 
-    BxDtAddMemory();
+    BxForEachMemoryRange(BxDtAddMemoryBank, nullptr);
     BxDtAddCpus();
 
     BxDtCreateSocNode();
@@ -270,6 +291,7 @@ static void BxDtPopulate() {
     BxDtAddDisks();
     BxDtAddAmtsu();
     BxDtAddBoards();
+    BxDtAddFramebuffer();
 }
 
 BL_USED _Noreturn void BxMain(
@@ -0,0 +1,312 @@
+#include "checksum.h"
+#include "compiler.h"
+
+#define BI_CRC32_POLY 0xedb88320u
+#define BI_CRC32C_POLY 0x82f63b78u
+
+#define BI_XXH32_PRIME1 0x9e37'79b1u
+#define BI_XXH32_PRIME2 0x85eb'ca77u
+#define BI_XXH32_PRIME3 0xc2b2'ae3du
+#define BI_XXH32_PRIME4 0x27d4'eb2fu
+#define BI_XXH32_PRIME5 0x1656'67b1u
+
+#define BI_XXH64_PRIME1 0x9e37'79b1'85eb'ca87ull
+#define BI_XXH64_PRIME2 0xc2b2'ae3d'27d4'eb4full
+#define BI_XXH64_PRIME3 0x1656'67b1'9e37'79f9ull
+#define BI_XXH64_PRIME4 0x85eb'ca77'c2b2'ae63ull
+#define BI_XXH64_PRIME5 0x27d4'eb2f'1656'67c5ull
+
+typedef uint32_t __attribute__((may_alias)) BiCrcWord;
+
+struct BiCrcTable {
+    // Entries[k][b] is the crc of byte b followed by k zero bytes, which lets eight bytes be folded in at once
+    uint32_t Entries[8][256];
+    bool Ready;
+};
+
+static struct BiCrcTable BiCrc32Table;
+static struct BiCrcTable BiCrc32cTable;
+
+static void BiInitCrcTable(struct BiCrcTable *table, uint32_t poly) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (poly & -(crc & 1));
+        }
+
+        table->Entries[0][i] = crc;
+    }
+
+    for (size_t k = 1; k < BL_ARRAY_SIZE(table->Entries); k++) {
+        for (size_t i = 0; i < 256; i++) {
+            uint32_t prev = table->Entries[k - 1][i];
+            table->Entries[k][i] = (prev >> 8) ^ table->Entries[0][prev & 0xff];
+        }
+    }
+
+    table->Ready = true;
+}
+
+static uint32_t BiCrcByte(struct BiCrcTable *table, uint32_t crc, unsigned char byte) {
+    return (crc >> 8) ^ table->Entries[0][(crc ^ byte) & 0xff];
+}
+
+static uint32_t BiCrc(struct BiCrcTable *table, uint32_t poly, uint32_t crc, const void *data, size_t size) {
+    if (!table->Ready) BiInitCrcTable(table, poly);
+
+    const unsigned char *ptr = data;
+    crc = ~crc;
+
+    while (size != 0 && ((uintptr_t)ptr & (sizeof(BiCrcWord) - 1)) != 0) {
+        crc = BiCrcByte(table, crc, *ptr++);
+        size--;
+    }
+
+    // two aligned words per iteration, the first of which absorbs the running crc
+    while (size >= 2 * sizeof(BiCrcWord)) {
+        uint32_t low = crc ^ BL_LE32(((const BiCrcWord *)ptr)[0]);
+        uint32_t high = BL_LE32(((const BiCrcWord *)ptr)[1]);
+
+        crc = table->Entries[7][low & 0xff] ^ table->Entries[6][(low >> 8) & 0xff] ^
+              table->Entries[5][(low >> 16) & 0xff] ^ table->Entries[4][low >> 24] ^
+              table->Entries[3][high & 0xff] ^ table->Entries[2][(high >> 8) & 0xff] ^
+              table->Entries[1][(high >> 16) & 0xff] ^ table->Entries[0][high >> 24];
+
+        ptr += 2 * sizeof(BiCrcWord);
+        size -= 2 * sizeof(BiCrcWord);
+    }
+
+    while (size != 0) {
+        crc = BiCrcByte(table, crc, *ptr++);
+        size--;
+    }
+
+    return ~crc;
+}
+
+uint32_t BlCrc32(uint32_t crc, const void *data, size_t size) {
+    return BiCrc(&BiCrc32Table, BI_CRC32_POLY, crc, data, size);
+}
+
+uint32_t BlCrc32c(uint32_t crc, const void *data, size_t size) {
+    return BiCrc(&BiCrc32cTable, BI_CRC32C_POLY, crc, data, size);
+}
+
+// the data handed to the xxhash functions is not necessarily aligned
+static uint32_t BiLoadLe32(const unsigned char *data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint64_t BiLoadLe64(const unsigned char *data) {
+    return BiLoadLe32(data) | ((uint64_t)BiLoadLe32(data + 4) << 32);
+}
+
+static uint32_t BiRotate32(uint32_t value, unsigned count) {
+    return (value << count) | (value >> (32 - count));
+}
+
+static uint64_t BiRotate64(uint64_t value, unsigned count) {
+    return (value << count) | (value >> (64 - count));
+}
+
+// 32x32->64 bit multiply built from 16-bit halves, as xr17032 has no widening multiply and there is no libgcc
+static uint64_t BiMultiplyWide(uint32_t a, uint32_t b) {
+    uint32_t low = (a & 0xffff) * (b & 0xffff);
+    uint32_t cross1 = (a & 0xffff) * (b >> 16);
+    uint32_t cross2 = (a >> 16) * (b & 0xffff);
+    uint32_t high = (a >> 16) * (b >> 16);
+
+    uint32_t middle = (low >> 16) + (cross1 & 0xffff) + (cross2 & 0xffff);
+    high += (cross1 >> 16) + (cross2 >> 16) + (middle >> 16);
+    low = (low & 0xffff) | (middle << 16);
+
+    return ((uint64_t)high << 32) | low;
+}
+
+static uint64_t BiMultiply64(uint64_t a, uint64_t b) {
+    uint64_t result = BiMultiplyWide(a, b);
+    uint32_t high = (uint32_t)a * (uint32_t)(b >> 32) + (uint32_t)(a >> 32) * (uint32_t)b;
+
+    return result + ((uint64_t)high << 32);
+}
+
+static uint32_t BiXxh32Round(uint32_t lane, uint32_t input) {
+    lane += input * BI_XXH32_PRIME2;
+    return BiRotate32(lane, 13) * BI_XXH32_PRIME1;
+}
+
+static void BiXxh32Stripe(struct BlXxh32 *state, const unsigned char *data) {
+    for (size_t i = 0; i < BL_ARRAY_SIZE(state->Lanes); i++) {
+        state->Lanes[i] = BiXxh32Round(state->Lanes[i], BiLoadLe32(data + i * 4));
+    }
+}
+
+void BlXxh32Init(struct BlXxh32 *state) {
+    state->Lanes[0] = BI_XXH32_PRIME1 + BI_XXH32_PRIME2;
+    state->Lanes[1] = BI_XXH32_PRIME2;
+    state->Lanes[2] = 0;
+    state->Lanes[3] = -BI_XXH32_PRIME1;
+    state->Buffered = 0;
+    state->Length = 0;
+}
+
+void BlXxh32Update(struct BlXxh32 *state, const void *data, size_t size) {
+    const unsigned char *ptr = data;
+    state->Length += size;
+
+    if (state->Buffered != 0) {
+        size_t count = BL_MIN(sizeof(state->Buffer) - state->Buffered, size);
+        BlCopyMemory(state->Buffer + state->Buffered, ptr, count);
+
+        state->Buffered += count;
+        ptr += count;
+        size -= count;
+
+        if (state->Buffered != sizeof(state->Buffer)) return;
+
+        BiXxh32Stripe(state, state->Buffer);
+        state->Buffered = 0;
+    }
+
+    while (size >= sizeof(state->Buffer)) {
+        BiXxh32Stripe(state, ptr);
+        ptr += sizeof(state->Buffer);
+        size -= sizeof(state->Buffer);
+    }
+
+    BlCopyMemory(state->Buffer, ptr, size);
+    state->Buffered = size;
+}
+
+uint32_t BlXxh32Finish(struct BlXxh32 *state) {
+    uint32_t hash;
+
+    if (state->Length >= sizeof(state->Buffer)) {
+        hash = BiRotate32(state->Lanes[0], 1) + BiRotate32(state->Lanes[1], 7) + BiRotate32(state->Lanes[2], 12) +
+               BiRotate32(state->Lanes[3], 18);
+    } else {
+        hash = BI_XXH32_PRIME5;
+    }
+
+    hash += (uint32_t)state->Length;
+
+    const unsigned char *ptr = state->Buffer;
+    size_t size = state->Buffered;
+
+    for (; size >= 4; ptr += 4, size -= 4) {
+        hash += BiLoadLe32(ptr) * BI_XXH32_PRIME3;
+        hash = BiRotate32(hash, 17) * BI_XXH32_PRIME4;
+    }
+
+    for (; size != 0; ptr++, size--) {
+        hash += *ptr * BI_XXH32_PRIME5;
+        hash = BiRotate32(hash, 11) * BI_XXH32_PRIME1;
+    }
+
+    hash ^= hash >> 15;
+    hash *= BI_XXH32_PRIME2;
+    hash ^= hash >> 13;
+    hash *= BI_XXH32_PRIME3;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+static uint64_t BiXxh64Round(uint64_t lane, uint64_t input) {
+    lane += BiMultiply64(input, BI_XXH64_PRIME2);
+    return BiMultiply64(BiRotate64(lane, 31), BI_XXH64_PRIME1);
+}
+
+static uint64_t BiXxh64Merge(uint64_t hash, uint64_t lane) {
+    hash ^= BiXxh64Round(0, lane);
+    return BiMultiply64(hash, BI_XXH64_PRIME1) + BI_XXH64_PRIME4;
+}
+
+static void BiXxh64Stripe(struct BlXxh64 *state, const unsigned char *data) {
+    for (size_t i = 0; i < BL_ARRAY_SIZE(state->Lanes); i++) {
+        state->Lanes[i] = BiXxh64Round(state->Lanes[i], BiLoadLe64(data + i * 8));
+    }
+}
+
+void BlXxh64Init(struct BlXxh64 *state) {
+    state->Lanes[0] = BI_XXH64_PRIME1 + BI_XXH64_PRIME2;
+    state->Lanes[1] = BI_XXH64_PRIME2;
+    state->Lanes[2] = 0;
+    state->Lanes[3] = -BI_XXH64_PRIME1;
+    state->Buffered = 0;
+    state->Length = 0;
+}
+
+void BlXxh64Update(struct BlXxh64 *state, const void *data, size_t size) {
+    const unsigned char *ptr = data;
+    state->Length += size;
+
+    if (state->Buffered != 0) {
+        size_t count = BL_MIN(sizeof(state->Buffer) - state->Buffered, size);
+        BlCopyMemory(state->Buffer + state->Buffered, ptr, count);
+
+        state->Buffered += count;
+        ptr += count;
+        size -= count;
+
+        if (state->Buffered != sizeof(state->Buffer)) return;
+
+        BiXxh64Stripe(state, state->Buffer);
+        state->Buffered = 0;
+    }
+
+    while (size >= sizeof(state->Buffer)) {
+        BiXxh64Stripe(state, ptr);
+        ptr += sizeof(state->Buffer);
+        size -= sizeof(state->Buffer);
+    }
+
+    BlCopyMemory(state->Buffer, ptr, size);
+    state->Buffered = size;
+}
+
+uint64_t BlXxh64Finish(struct BlXxh64 *state) {
+    uint64_t hash;
+
+    if (state->Length >= sizeof(state->Buffer)) {
+        hash = BiRotate64(state->Lanes[0], 1) + BiRotate64(state->Lanes[1], 7) + BiRotate64(state->Lanes[2], 12) +
+               BiRotate64(state->Lanes[3], 18);
+
+        for (size_t i = 0; i < BL_ARRAY_SIZE(state->Lanes); i++) {
+            hash = BiXxh64Merge(hash, state->Lanes[i]);
+        }
+    } else {
+        hash = BI_XXH64_PRIME5;
+    }
+
+    hash += state->Length;
+
+    const unsigned char *ptr = state->Buffer;
+    size_t size = state->Buffered;
+
+    for (; size >= 8; ptr += 8, size -= 8) {
+        hash ^= BiXxh64Round(0, BiLoadLe64(ptr));
+        hash = BiMultiply64(BiRotate64(hash, 27), BI_XXH64_PRIME1) + BI_XXH64_PRIME4;
+    }
+
+    if (size >= 4) {
+        hash ^= BiMultiply64(BiLoadLe32(ptr), BI_XXH64_PRIME1);
+        hash = BiMultiply64(BiRotate64(hash, 23), BI_XXH64_PRIME2) + BI_XXH64_PRIME3;
+        ptr += 4;
+        size -= 4;
+    }
+
+    for (; size != 0; ptr++, size--) {
+        hash ^= BiMultiply64(*ptr, BI_XXH64_PRIME5);
+        hash = BiMultiply64(BiRotate64(hash, 11), BI_XXH64_PRIME1);
+    }
+
+    hash ^= hash >> 33;
+    hash = BiMultiply64(hash, BI_XXH64_PRIME2);
+    hash ^= hash >> 29;
+    hash = BiMultiply64(hash, BI_XXH64_PRIME3);
+    hash ^= hash >> 32;
+
+    return hash;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct BlXxh32 {
+    uint32_t Lanes[4];
+    unsigned char Buffer[16];
+    size_t Buffered;
+    uint64_t Length;
+};
+
+struct BlXxh64 {
+    uint64_t Lanes[4];
+    unsigned char Buffer[32];
+    size_t Buffered;
+    uint64_t Length;
+};
+
+// Continues the CRC32 (as used by gzip) of a stream with the next `size` bytes of it. Start with a crc of 0.
+uint32_t BlCrc32(uint32_t crc, const void *data, size_t size);
+
+// Continues the CRC32C (Castagnoli) of a stream with the next `size` bytes of it. Start with a crc of 0.
+uint32_t BlCrc32c(uint32_t crc, const void *data, size_t size);
+
+// Incremental XXH32 and XXH64 with a seed of 0, as used by the LZ4 and zstd frame formats.
+void BlXxh32Init(struct BlXxh32 *state);
+void BlXxh32Update(struct BlXxh32 *state, const void *data, size_t size);
+uint32_t BlXxh32Finish(struct BlXxh32 *state);
+
+void BlXxh64Init(struct BlXxh64 *state);
+void BlXxh64Update(struct BlXxh64 *state, const void *data, size_t size);
+uint64_t BlXxh64Finish(struct BlXxh64 *state);
@@ -104,6 +104,36 @@ static inline size_t BlStringLength(const char *str) {
     return __builtin_strlen(str);
 }
 
+static inline int BlCountLeadingZeroes(unsigned value) {
+    int count = 0;
+
+    if ((value & 0xffff'0000) == 0) {
+        count += 16;
+        value <<= 16;
+    }
+
+    if ((value & 0xff00'0000) == 0) {
+        count += 8;
+        value <<= 8;
+    }
+
+    if ((value & 0xf000'0000) == 0) {
+        count += 4;
+        value <<= 4;
+    }
+
+    if ((value & 0xc000'0000) == 0) {
+        count += 2;
+        value <<= 2;
+    }
+
+    if ((value & 0x8000'0000) == 0) {
+        count += 1;
+    }
+
+    return count;
+}
+
 static inline int BlCountTrailingZeroes(unsigned value) {
     int count = 0;
 
@@ -7,9 +7,11 @@ const char *BlKernelPath;
 const char *BlStdoutPath;
 const char *BlInitrdPath;
 const char *BlCommandLine;
+bool BlQuiet;
 
 enum BiOptionType {
     BI_OPTION_STRING,
+    BI_OPTION_BOOLEAN,
 };
 
 #define BI_REQUIRED (1u << 0)
@@ -27,6 +29,7 @@ static struct BiOption BiOptions[] = {
     {"StdoutPath", BI_OPTION_STRING, 0, &BlStdoutPath},
     {"InitrdPath", BI_OPTION_STRING, 0, &BlInitrdPath},
     {"CommandLine", BI_OPTION_STRING, 0, &BlCommandLine},
+    {"Quiet", BI_OPTION_BOOLEAN, 0, &BlQuiet},
 };
 
 static void BiValidateOptions(void) {
@@ -55,6 +58,10 @@ static struct BiOption *BlFindOption(const char *name, size_t nameLength) {
     return nullptr;
 }
 
+static bool BiValueEquals(const char *value, size_t valueLength, const char *str) {
+    return BlStringLength(str) == valueLength && BlCompareMemory(value, str, valueLength) == 0;
+}
+
 static void BiHandleOption(const char *name, size_t nameLength, const char *value, size_t valueLength) {
     struct BiOption *option = BlFindOption(name, nameLength);
 
@@ -71,6 +78,15 @@ static void BiHandleOption(const char *name, size_t nameLength, const char *valu
         *(const char **)option->Value = buffer;
         break;
     }
+    case BI_OPTION_BOOLEAN:
+        if (BiValueEquals(value, valueLength, "true")) {
+            *(bool *)option->Value = true;
+        } else if (BiValueEquals(value, valueLength, "false")) {
+            *(bool *)option->Value = false;
+        } else {
+            BlCrash("invalid value for option `%s` (expected `true` or `false`)", option->Name);
+        }
+        break;
     }
 
     option->Flags |= BI_PROVIDED;
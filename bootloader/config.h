@@ -7,4 +7,7 @@ extern const char *BlStdoutPath;
 extern const char *BlInitrdPath;
 extern const char *BlCommandLine;
 
+// keeps boot messages off the console; they still end up in the boot log
+extern bool BlQuiet;
+
 void BlLoadConfigurationFromFile(struct BlFsFile *file);
@@ -0,0 +1,1628 @@
+#include "decompress.h"
+#include "checksum.h"
+#include "compiler.h"
+#include "logging.h"
+#include "memory.h"
+#include "platform.h"
+#include "platformdefs.h"
+
+#define BI_INPUT_SIZE 0x2'0000u
+
+// the output buffer holds the history window plus this much room for new output
+#define BI_MIN_SLACK 0x4'0000u
+#define BI_MAX_SLACK 0x10'0000u
+
+#define BI_GZIP_MAGIC 0x8b1f
+#define BI_LZ4_MAGIC 0x184d2204
+#define BI_ZSTD_MAGIC 0xfd2fb528
+#define BI_SKIPPABLE_MAGIC 0x184d2a50
+#define BI_SKIPPABLE_MASK 0xfffffff0
+
+#define BI_GZIP_DEFLATE 8
+#define BI_GZIP_HCRC (1u << 1)
+#define BI_GZIP_EXTRA (1u << 2)
+#define BI_GZIP_NAME (1u << 3)
+#define BI_GZIP_COMMENT (1u << 4)
+#define BI_GZIP_RESERVED 0xe0
+
+#define BI_INFLATE_WINDOW 0x8000
+#define BI_INFLATE_MAX_MATCH 258
+#define BI_INFLATE_MAX_BITS 15
+#define BI_INFLATE_FAST_BITS 10
+#define BI_INFLATE_LITERALS 288
+#define BI_INFLATE_DISTANCES 30
+
+#define BI_LZ4_WINDOW 0x1'0000
+#define BI_LZ4_VERSION 0x40
+#define BI_LZ4_VERSION_MASK 0xc0
+#define BI_LZ4_BLOCK_CHECKSUM (1u << 4)
+#define BI_LZ4_CONTENT_SIZE (1u << 3)
+#define BI_LZ4_CONTENT_CHECKSUM (1u << 2)
+#define BI_LZ4_DICT_ID (1u << 0)
+#define BI_LZ4_RESERVED 0x02
+#define BI_LZ4_BD_RESERVED 0x8f
+#define BI_LZ4_UNCOMPRESSED (1u << 31)
+#define BI_LZ4_MIN_MATCH 4
+
+#define BI_ZSTD_MIN_WINDOW_LOG 10
+#define BI_ZSTD_MAX_WINDOW_LOG 27
+#define BI_ZSTD_BLOCK_MAX 0x2'0000
+#define BI_ZSTD_SINGLE_SEGMENT (1u << 5)
+#define BI_ZSTD_RESERVED (1u << 3)
+#define BI_ZSTD_CHECKSUM (1u << 2)
+#define BI_ZSTD_HUFFMAN_MAX_BITS 11
+#define BI_ZSTD_HUFFMAN_MAX_SYMBOLS 256
+#define BI_ZSTD_FSE_MIN_LOG 5
+#define BI_ZSTD_FSE_MAX_LOG 9
+#define BI_ZSTD_WEIGHT_MAX_LOG 6
+#define BI_ZSTD_LL_MAX_LOG 9
+#define BI_ZSTD_ML_MAX_LOG 9
+#define BI_ZSTD_OF_MAX_LOG 8
+#define BI_ZSTD_LL_SYMBOLS 36
+#define BI_ZSTD_ML_SYMBOLS 53
+#define BI_ZSTD_OF_SYMBOLS 32
+
+enum BiFormat {
+    BI_FORMAT_GZIP,
+    BI_FORMAT_LZ4,
+    BI_FORMAT_ZSTD,
+};
+
+struct BiHuffman {
+    uint16_t Fast[1u << BI_INFLATE_FAST_BITS];
+    uint16_t Count[BI_INFLATE_MAX_BITS + 1];
+    uint16_t Symbol[BI_INFLATE_LITERALS];
+};
+
+enum BiInflateState {
+    BI_INFLATE_BLOCK,
+    BI_INFLATE_STORED,
+    BI_INFLATE_CODES,
+    BI_INFLATE_TRAILER,
+};
+
+struct BiInflate {
+    enum BiInflateState State;
+    bool LastBlock;
+    uint32_t BitBuffer;
+    unsigned BitCount;
+    size_t StoredLeft;
+    uint32_t MemberSize;
+    uint32_t MemberCrc;
+    struct BiHuffman Literals;
+    struct BiHuffman Distances;
+};
+
+enum BiLz4State {
+    BI_LZ4_BLOCK,
+    BI_LZ4_SEQUENCE,
+    BI_LZ4_LITERALS,
+    BI_LZ4_MATCH,
+    BI_LZ4_RAW,
+};
+
+struct BiLz4 {
+    enum BiLz4State State;
+    uint8_t Flags;
+    size_t BlockMax;
+    size_t BlockLeft;
+    size_t LiteralsLeft;
+    size_t MatchLeft;
+    size_t MatchOffset;
+    uint8_t Token;
+    struct BlXxh32 Hash;
+};
+
+struct BiFseEntry {
+    uint8_t Symbol;
+    uint8_t Bits;
+    uint16_t Base;
+};
+
+struct BiFseTable {
+    unsigned Log;
+    bool Valid;
+    struct BiFseEntry Entries[1u << BI_ZSTD_FSE_MAX_LOG];
+};
+
+struct BiZstd {
+    bool LastBlock;
+    bool Checksum;
+    struct BlXxh64 Hash;
+    size_t WindowSize;
+    size_t BlockMax;
+    size_t RepeatOffsets[3];
+    unsigned char *Literals;
+    unsigned HuffmanBits;
+    bool HuffmanValid;
+    uint16_t Huffman[1u << BI_ZSTD_HUFFMAN_MAX_BITS];
+    struct BiFseTable LiteralLengths;
+    struct BiFseTable MatchLengths;
+    struct BiFseTable Offsets;
+    struct BiFseTable Weights;
+};
+
+struct BlDecompressor {
+    struct BlFsFile *File;
+    uint64_t FileSize;
+    uint64_t FilePosition;
+    unsigned char *Input;
+    size_t InputCapacity;
+    size_t InputHead;
+    size_t InputTail;
+    // Head is where new output is written, Tail is the next byte to hand out. The WindowSize bytes before Head are
+    // kept around when the buffer is recycled, as later output can copy from them.
+    unsigned char *Buffer;
+    size_t BufferSize;
+    size_t WindowSize;
+    size_t Unit;
+    size_t Head;
+    size_t Tail;
+    // output before Checked has been folded into the checksum of the current frame
+    size_t Checked;
+    bool Finished;
+    uint64_t SizeHint;
+    enum BiFormat Format;
+    union {
+        struct BiInflate Inflate;
+        struct BiLz4 Lz4;
+        struct BiZstd Zstd;
+    };
+};
+
+static unsigned BiHighBit(uint32_t value) {
+    unsigned bit = 0;
+    while (value >>= 1) bit++;
+    return bit;
+}
+
+static bool BiRefillInput(struct BlDecompressor *dec) {
+    if (dec->FilePosition >= dec->FileSize) return false;
+
+    // move the unconsumed input so that the new data lands on a sector boundary and can bypass the cache
+    size_t remaining = dec->InputTail - dec->InputHead;
+    size_t pad = BL_ALIGN_UP(remaining, BL_SECTOR_SIZE) - remaining;
+    BlCopyMemoryOverlapping(dec->Input + pad, dec->Input + dec->InputHead, remaining);
+    dec->InputHead = pad;
+    dec->InputTail = pad + remaining;
+
+    size_t count = BL_MIN(dec->FileSize - dec->FilePosition, dec->InputCapacity - dec->InputTail);
+    BlFsFileRead(dec->File, dec->Input + dec->InputTail, count, dec->FilePosition, true);
+
+    dec->InputTail += count;
+    dec->FilePosition += count;
+    return count != 0;
+}
+
+static bool BiEnsureInput(struct BlDecompressor *dec, size_t count) {
+    while (dec->InputTail - dec->InputHead < count) {
+        if (!BiRefillInput(dec)) return false;
+    }
+
+    return true;
+}
+
+static bool BiInputAtEnd(struct BlDecompressor *dec) {
+    return dec->InputHead == dec->InputTail && dec->FilePosition >= dec->FileSize;
+}
+
+static void BiRequireInput(struct BlDecompressor *dec, size_t count) {
+    if (!BiEnsureInput(dec, count)) BlCrash("compressed image is truncated");
+}
+
+static uint8_t BiInputByte(struct BlDecompressor *dec) {
+    if (dec->InputHead == dec->InputTail) BiRequireInput(dec, 1);
+    return dec->Input[dec->InputHead++];
+}
+
+static uint32_t BiInputLe32(struct BlDecompressor *dec) {
+    BiRequireInput(dec, 4);
+
+    const unsigned char *data = dec->Input + dec->InputHead;
+    dec->InputHead += 4;
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint64_t BiInputLe(struct BlDecompressor *dec, size_t count) {
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        value |= (uint64_t)BiInputByte(dec) << (i * 8);
+    }
+
+    return value;
+}
+
+static void BiInputCopy(struct BlDecompressor *dec, void *buffer, size_t count) {
+    while (count != 0) {
+        if (dec->InputHead == dec->InputTail) BiRequireInput(dec, 1);
+
+        size_t current = BL_MIN(dec->InputTail - dec->InputHead, count);
+        BlCopyMemory(buffer, dec->Input + dec->InputHead, current);
+
+        dec->InputHead += current;
+        buffer += current;
+        count -= current;
+    }
+}
+
+static void BiSkipInput(struct BlDecompressor *dec, uint64_t count) {
+    while (count != 0) {
+        if (dec->InputHead == dec->InputTail) BiRequireInput(dec, 1);
+
+        size_t current = BL_MIN(dec->InputTail - dec->InputHead, count);
+        dec->InputHead += current;
+        count -= current;
+    }
+}
+
+static size_t BiOutputSpace(struct BlDecompressor *dec) {
+    return dec->BufferSize - dec->Head;
+}
+
+// folds the output produced since the last call into the checksum of the current frame
+static void BiUpdateChecksum(struct BlDecompressor *dec) {
+    const unsigned char *data = dec->Buffer + dec->Checked;
+    size_t size = dec->Head - dec->Checked;
+    dec->Checked = dec->Head;
+
+    switch (dec->Format) {
+    case BI_FORMAT_GZIP: dec->Inflate.MemberCrc = BlCrc32(dec->Inflate.MemberCrc, data, size); break;
+    case BI_FORMAT_LZ4:
+        if (dec->Lz4.Flags & BI_LZ4_CONTENT_CHECKSUM) BlXxh32Update(&dec->Lz4.Hash, data, size);
+        break;
+    case BI_FORMAT_ZSTD:
+        if (dec->Zstd.Checksum) BlXxh64Update(&dec->Zstd.Hash, data, size);
+        break;
+    }
+}
+
+static void BiCopyMatch(struct BlDecompressor *dec, size_t offset, size_t count) {
+    if (offset == 0 || offset > dec->Head) BlCrash("compressed image contains an invalid match offset");
+
+    unsigned char *dest = dec->Buffer + dec->Head;
+    const unsigned char *src = dest - offset;
+    dec->Head += count;
+
+    if (offset >= count) {
+        BlCopyMemory(dest, src, count);
+    } else {
+        while (count--) *dest++ = *src++;
+    }
+}
+
+// gzip
+
+static const uint16_t BiLengthBase[] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23,  27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+
+static const uint8_t BiLengthExtra[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+
+static const uint16_t BiDistanceBase[] = {
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+
+static const uint8_t BiDistanceExtra[] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static const uint8_t BiCodeLengthOrder[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+static void BiInflateFill(struct BlDecompressor *dec) {
+    struct BiInflate *inf = &dec->Inflate;
+
+    while (inf->BitCount <= 24) {
+        if (dec->InputHead == dec->InputTail && !BiRefillInput(dec)) return;
+
+        inf->BitBuffer |= (uint32_t)dec->Input[dec->InputHead++] << inf->BitCount;
+        inf->BitCount += 8;
+    }
+}
+
+static uint32_t BiInflateBits(struct BlDecompressor *dec, unsigned count) {
+    struct BiInflate *inf = &dec->Inflate;
+
+    if (inf->BitCount < count) {
+        BiInflateFill(dec);
+        if (inf->BitCount < count) BlCrash("compressed image is truncated");
+    }
+
+    uint32_t value = inf->BitBuffer & ((1u << count) - 1);
+    inf->BitBuffer >>= count;
+    inf->BitCount -= count;
+    return value;
+}
+
+static void BiInflateAlign(struct BlDecompressor *dec) {
+    struct BiInflate *inf = &dec->Inflate;
+    unsigned extra = inf->BitCount & 7;
+
+    inf->BitBuffer >>= extra;
+    inf->BitCount -= extra;
+}
+
+static void BiBuildHuffman(struct BiHuffman *huffman, const uint8_t *lengths, size_t count) {
+    BlFillMemory(huffman, 0, sizeof(*huffman));
+
+    for (size_t i = 0; i < count; i++) {
+        huffman->Count[lengths[i]] += 1;
+    }
+
+    huffman->Count[0] = 0;
+
+    uint16_t offsets[BI_INFLATE_MAX_BITS + 1];
+    uint16_t codes[BI_INFLATE_MAX_BITS + 1];
+    int left = 1;
+    unsigned code = 0;
+    offsets[1] = 0;
+
+    for (size_t i = 1; i <= BI_INFLATE_MAX_BITS; i++) {
+        left = (left << 1) - huffman->Count[i];
+        if (left < 0) BlCrash("compressed image contains an invalid huffman code");
+
+        code = (code + huffman->Count[i - 1]) << 1;
+        codes[i] = code;
+        if (i < BI_INFLATE_MAX_BITS) offsets[i + 1] = offsets[i] + huffman->Count[i];
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        unsigned length = lengths[i];
+        if (length == 0) continue;
+
+        huffman->Symbol[offsets[length]++] = i;
+
+        unsigned value = codes[length]++;
+        if (length > BI_INFLATE_FAST_BITS) continue;
+
+        // codes are stored most significant bit first, so the table is indexed by the reversed code
+        unsigned reversed = 0;
+
+        for (unsigned j = 0; j < length; j++) {
+            reversed = (reversed << 1) | ((value >> j) & 1);
+        }
+
+        for (unsigned j = reversed; j < BL_ARRAY_SIZE(huffman->Fast); j += 1u << length) {
+            huffman->Fast[j] = (i << 4) | length;
+        }
+    }
+}
+
+static unsigned BiDecodeHuffman(struct BlDecompressor *dec, struct BiHuffman *huffman) {
+    struct BiInflate *inf = &dec->Inflate;
+    if (inf->BitCount < BI_INFLATE_MAX_BITS) BiInflateFill(dec);
+
+    unsigned entry = huffman->Fast[inf->BitBuffer & (BL_ARRAY_SIZE(huffman->Fast) - 1)];
+    unsigned length = entry & 15;
+
+    if (length != 0 && length <= inf->BitCount) {
+        inf->BitBuffer >>= length;
+        inf->BitCount -= length;
+        return entry >> 4;
+    }
+
+    int code = 0;
+    int first = 0;
+    int index = 0;
+
+    for (length = 1; length <= BI_INFLATE_MAX_BITS && length <= inf->BitCount; length++) {
+        code |= (inf->BitBuffer >> (length - 1)) & 1;
+
+        int count = huffman->Count[length];
+
+        if (code - count < first) {
+            inf->BitBuffer >>= length;
+            inf->BitCount -= length;
+            return huffman->Symbol[index + (code - first)];
+        }
+
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+
+    BlCrash("compressed image contains an invalid huffman code");
+}
+
+static void BiInflateFixed(struct BlDecompressor *dec) {
+    uint8_t lengths[BI_INFLATE_LITERALS];
+
+    BlFillMemory(lengths, 8, 144);
+    BlFillMemory(lengths + 144, 9, 256 - 144);
+    BlFillMemory(lengths + 256, 7, 280 - 256);
+    BlFillMemory(lengths + 280, 8, BI_INFLATE_LITERALS - 280);
+    BiBuildHuffman(&dec->Inflate.Literals, lengths, BI_INFLATE_LITERALS);
+
+    BlFillMemory(lengths, 5, BI_INFLATE_DISTANCES);
+    BiBuildHuffman(&dec->Inflate.Distances, lengths, BI_INFLATE_DISTANCES);
+}
+
+static void BiInflateDynamic(struct BlDecompressor *dec) {
+    size_t literals = BiInflateBits(dec, 5) + 257;
+    size_t distances = BiInflateBits(dec, 5) + 1;
+    size_t codeLengths = BiInflateBits(dec, 4) + 4;
+
+    if (literals > 286 || distances > BI_INFLATE_DISTANCES) BlCrash("compressed image contains an invalid block");
+
+    uint8_t lengths[BI_INFLATE_LITERALS + BI_INFLATE_DISTANCES];
+    BlFillMemory(lengths, 0, BL_ARRAY_SIZE(BiCodeLengthOrder));
+
+    for (size_t i = 0; i < codeLengths; i++) {
+        lengths[BiCodeLengthOrder[i]] = BiInflateBits(dec, 3);
+    }
+
+    BiBuildHuffman(&dec->Inflate.Literals, lengths, BL_ARRAY_SIZE(BiCodeLengthOrder));
+
+    size_t i = 0;
+
+    while (i < literals + distances) {
+        unsigned symbol = BiDecodeHuffman(dec, &dec->Inflate.Literals);
+
+        if (symbol < 16) {
+            lengths[i++] = symbol;
+            continue;
+        }
+
+        uint8_t value = 0;
+        size_t repeat;
+
+        if (symbol == 16) {
+            if (i == 0) BlCrash("compressed image contains an invalid block");
+            value = lengths[i - 1];
+            repeat = 3 + BiInflateBits(dec, 2);
+        } else if (symbol == 17) {
+            repeat = 3 + BiInflateBits(dec, 3);
+        } else {
+            repeat = 11 + BiInflateBits(dec, 7);
+        }
+
+        if (repeat > literals + distances - i) BlCrash("compressed image contains an invalid block");
+
+        BlFillMemory(lengths + i, value, repeat);
+        i += repeat;
+    }
+
+    if (lengths[256] == 0) BlCrash("compressed image contains an invalid block");
+
+    BiBuildHuffman(&dec->Inflate.Literals, lengths, literals);
+    BiBuildHuffman(&dec->Inflate.Distances, lengths + literals, distances);
+}
+
+static void BiGzipReadHeader(struct BlDecompressor *dec) {
+    if (BiInflateBits(dec, 16) != BI_GZIP_MAGIC) BlCrash("invalid gzip header");
+    if (BiInflateBits(dec, 8) != BI_GZIP_DEFLATE) BlCrash("unsupported gzip compression method");
+
+    unsigned flags = BiInflateBits(dec, 8);
+    if (flags & BI_GZIP_RESERVED) BlCrash("invalid gzip header");
+
+    // modification time, extra flags and operating system
+    for (size_t i = 0; i < 6; i++) BiInflateBits(dec, 8);
+
+    if (flags & BI_GZIP_EXTRA) {
+        size_t length = BiInflateBits(dec, 16);
+        while (length--) BiInflateBits(dec, 8);
+    }
+
+    if (flags & BI_GZIP_NAME) {
+        while (BiInflateBits(dec, 8) != 0);
+    }
+
+    if (flags & BI_GZIP_COMMENT) {
+        while (BiInflateBits(dec, 8) != 0);
+    }
+
+    if (flags & BI_GZIP_HCRC) BiInflateBits(dec, 16);
+
+    dec->Inflate.State = BI_INFLATE_BLOCK;
+    dec->Inflate.LastBlock = false;
+    dec->Inflate.MemberSize = 0;
+    dec->Inflate.MemberCrc = 0;
+}
+
+static void BiGzipReadTrailer(struct BlDecompressor *dec) {
+    struct BiInflate *inf = &dec->Inflate;
+
+    BiInflateAlign(dec);
+    BiUpdateChecksum(dec);
+
+    uint32_t crc = BiInflateBits(dec, 16);
+    crc |= BiInflateBits(dec, 16) << 16;
+    if (crc != inf->MemberCrc) BlCrash("gzip member has the wrong checksum");
+
+    uint32_t size = BiInflateBits(dec, 16);
+    size |= BiInflateBits(dec, 16) << 16;
+    if (size != inf->MemberSize) BlCrash("gzip member has the wrong size");
+
+    BiInflateFill(dec);
+
+    if (inf->BitCount >= 16 && (inf->BitBuffer & 0xffff) == BI_GZIP_MAGIC) {
+        BiGzipReadHeader(dec);
+    } else {
+        // anything after the last member is padding
+        dec->Finished = true;
+    }
+}
+
+static void BiInflateStored(struct BlDecompressor *dec) {
+    struct BiInflate *inf = &dec->Inflate;
+
+    size_t count = BL_MIN(inf->StoredLeft, BiOutputSpace(dec));
+    unsigned char *dest = dec->Buffer + dec->Head;
+
+    dec->Head += count;
+    inf->StoredLeft -= count;
+    inf->MemberSize += count;
+
+    // the bit buffer may still hold some of the stored bytes
+    while (count != 0 && inf->BitCount != 0) {
+        *dest++ = BiInflateBits(dec, 8);
+        count -= 1;
+    }
+
+    BiInputCopy(dec, dest, count);
+
+    if (inf->StoredLeft == 0) inf->State = BI_INFLATE_BLOCK;
+}
+
+static void BiInflateCodes(struct BlDecompressor *dec) {
+    struct BiInflate *inf = &dec->Inflate;
+
+    while (dec->Head + BI_INFLATE_MAX_MATCH <= dec->BufferSize) {
+        unsigned symbol = BiDecodeHuffman(dec, &inf->Literals);
+
+        if (symbol < 256) {
+            dec->Buffer[dec->Head++] = symbol;
+            inf->MemberSize += 1;
+            continue;
+        }
+
+        if (symbol == 256) {
+            inf->State = BI_INFLATE_BLOCK;
+            return;
+        }
+
+        symbol -= 257;
+        if (symbol >= BL_ARRAY_SIZE(BiLengthBase)) BlCrash("compressed image contains an invalid length");
+
+        size_t length = BiLengthBase[symbol] + BiInflateBits(dec, BiLengthExtra[symbol]);
+
+        symbol = BiDecodeHuffman(dec, &inf->Distances);
+        if (symbol >= BL_ARRAY_SIZE(BiDistanceBase)) BlCrash("compressed image contains an invalid distance");
+
+        size_t distance = BiDistanceBase[symbol] + BiInflateBits(dec, BiDistanceExtra[symbol]);
+
+        BiCopyMatch(dec, distance, length);
+        inf->MemberSize += length;
+    }
+}
+
+static void BiInflateStep(struct BlDecompressor *dec) {
+    struct BiInflate *inf = &dec->Inflate;
+
+    switch (inf->State) {
+    case BI_INFLATE_BLOCK: {
+        if (inf->LastBlock) {
+            inf->State = BI_INFLATE_TRAILER;
+            break;
+        }
+
+        inf->LastBlock = BiInflateBits(dec, 1);
+
+        switch (BiInflateBits(dec, 2)) {
+        case 0: {
+            BiInflateAlign(dec);
+
+            size_t length = BiInflateBits(dec, 16);
+            size_t check = BiInflateBits(dec, 16);
+            if (length != (~check & 0xffff)) BlCrash("compressed image contains an invalid stored block");
+
+            inf->StoredLeft = length;
+            inf->State = BI_INFLATE_STORED;
+            break;
+        }
+        case 1:
+            BiInflateFixed(dec);
+            inf->State = BI_INFLATE_CODES;
+            break;
+        case 2:
+            BiInflateDynamic(dec);
+            inf->State = BI_INFLATE_CODES;
+            break;
+        default: BlCrash("compressed image contains an invalid block");
+        }
+
+        break;
+    }
+    case BI_INFLATE_STORED: BiInflateStored(dec); break;
+    case BI_INFLATE_CODES: BiInflateCodes(dec); break;
+    case BI_INFLATE_TRAILER: BiGzipReadTrailer(dec); break;
+    }
+}
+
+// lz4
+
+static void BiLz4ReadFrameHeader(struct BlDecompressor *dec) {
+    struct BiLz4 *lz4 = &dec->Lz4;
+
+    while (true) {
+        uint32_t magic = BiInputLe32(dec);
+        if (magic == BI_LZ4_MAGIC) break;
+        if ((magic & BI_SKIPPABLE_MASK) != BI_SKIPPABLE_MAGIC) BlCrash("invalid lz4 frame header");
+
+        BiSkipInput(dec, BiInputLe32(dec));
+    }
+
+    uint8_t flags = BiInputByte(dec);
+    uint8_t descriptor = BiInputByte(dec);
+
+    if ((flags & BI_LZ4_VERSION_MASK) != BI_LZ4_VERSION || (flags & BI_LZ4_RESERVED) ||
+        (descriptor & BI_LZ4_BD_RESERVED) || (descriptor >> 4) < 4) {
+        BlCrash("invalid lz4 frame header");
+    }
+
+    if (flags & BI_LZ4_DICT_ID) BlCrash("lz4 dictionaries are not supported");
+
+    // the header checksum covers the descriptor, which is at most 10 bytes without a dictionary id
+    unsigned char header[10];
+    size_t headerSize = 0;
+
+    header[headerSize++] = flags;
+    header[headerSize++] = descriptor;
+
+    if (flags & BI_LZ4_CONTENT_SIZE) {
+        uint64_t size = BiInputLe(dec, 8);
+        if (dec->SizeHint == 0) dec->SizeHint = size;
+
+        for (size_t i = 0; i < 8; i++) {
+            header[headerSize++] = size >> (i * 8);
+        }
+    }
+
+    BlXxh32Init(&lz4->Hash);
+    BlXxh32Update(&lz4->Hash, header, headerSize);
+    if (BiInputByte(dec) != ((BlXxh32Finish(&lz4->Hash) >> 8) & 0xff)) BlCrash("invalid lz4 frame header");
+
+    BlXxh32Init(&lz4->Hash);
+    lz4->Flags = flags;
+    lz4->BlockMax = 1u << (8 + 2 * (descriptor >> 4));
+    lz4->State = BI_LZ4_BLOCK;
+}
+
+static size_t BiLz4Length(struct BlDecompressor *dec, size_t length) {
+    struct BiLz4 *lz4 = &dec->Lz4;
+    if (length != 15) return length;
+
+    uint8_t value;
+
+    do {
+        if (lz4->BlockLeft == 0) BlCrash("compressed image contains an invalid lz4 block");
+
+        value = BiInputByte(dec);
+        lz4->BlockLeft -= 1;
+        length += value;
+    } while (value == 255);
+
+    return length;
+}
+
+static void BiLz4EndBlock(struct BlDecompressor *dec) {
+    struct BiLz4 *lz4 = &dec->Lz4;
+
+    if (lz4->Flags & BI_LZ4_BLOCK_CHECKSUM) BiSkipInput(dec, 4);
+    lz4->State = BI_LZ4_BLOCK;
+}
+
+static void BiLz4Step(struct BlDecompressor *dec) {
+    struct BiLz4 *lz4 = &dec->Lz4;
+
+    switch (lz4->State) {
+    case BI_LZ4_BLOCK: {
+        uint32_t size = BiInputLe32(dec);
+
+        if (size == 0) {
+            BiUpdateChecksum(dec);
+
+            if ((lz4->Flags & BI_LZ4_CONTENT_CHECKSUM) && BiInputLe32(dec) != BlXxh32Finish(&lz4->Hash)) {
+                BlCrash("lz4 frame has the wrong checksum");
+            }
+
+            if (BiInputAtEnd(dec)) {
+                dec->Finished = true;
+            } else {
+                BiLz4ReadFrameHeader(dec);
+            }
+
+            break;
+        }
+
+        lz4->BlockLeft = size & ~BI_LZ4_UNCOMPRESSED;
+        if (lz4->BlockLeft > lz4->BlockMax) BlCrash("compressed image contains an invalid lz4 block");
+
+        if (size & BI_LZ4_UNCOMPRESSED) {
+            lz4->State = BI_LZ4_RAW;
+        } else {
+            lz4->State = BI_LZ4_SEQUENCE;
+        }
+
+        break;
+    }
+    case BI_LZ4_SEQUENCE:
+        if (lz4->BlockLeft == 0) BlCrash("compressed image contains an invalid lz4 block");
+
+        lz4->Token = BiInputByte(dec);
+        lz4->BlockLeft -= 1;
+        lz4->LiteralsLeft = BiLz4Length(dec, lz4->Token >> 4);
+        lz4->State = BI_LZ4_LITERALS;
+        break;
+    case BI_LZ4_LITERALS: {
+        size_t count = BL_MIN(lz4->LiteralsLeft, BiOutputSpace(dec));
+        if (count > lz4->BlockLeft) BlCrash("compressed image contains an invalid lz4 block");
+
+        BiInputCopy(dec, dec->Buffer + dec->Head, count);
+        dec->Head += count;
+        lz4->LiteralsLeft -= count;
+        lz4->BlockLeft -= count;
+
+        if (lz4->LiteralsLeft != 0) break;
+
+        // the last sequence of a block has no match
+        if (lz4->BlockLeft == 0) {
+            BiLz4EndBlock(dec);
+            break;
+        }
+
+        if (lz4->BlockLeft < 2) BlCrash("compressed image contains an invalid lz4 block");
+
+        lz4->MatchOffset = BiInputByte(dec);
+        lz4->MatchOffset |= BiInputByte(dec) << 8;
+        lz4->BlockLeft -= 2;
+        lz4->MatchLeft = BiLz4Length(dec, lz4->Token & 15) + BI_LZ4_MIN_MATCH;
+        lz4->State = BI_LZ4_MATCH;
+        break;
+    }
+    case BI_LZ4_MATCH: {
+        size_t count = BL_MIN(lz4->MatchLeft, BiOutputSpace(dec));
+
+        BiCopyMatch(dec, lz4->MatchOffset, count);
+        lz4->MatchLeft -= count;
+
+        if (lz4->MatchLeft == 0) lz4->State = BI_LZ4_SEQUENCE;
+        break;
+    }
+    case BI_LZ4_RAW: {
+        size_t count = BL_MIN(lz4->BlockLeft, BiOutputSpace(dec));
+
+        BiInputCopy(dec, dec->Buffer + dec->Head, count);
+        dec->Head += count;
+        lz4->BlockLeft -= count;
+
+        if (lz4->BlockLeft == 0) BiLz4EndBlock(dec);
+        break;
+    }
+    }
+}
+
+// zstd
+
+static const int16_t BiDefaultLiteralLengths[BI_ZSTD_LL_SYMBOLS] = {
+    4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1, -1, -1, -1, -1,
+};
+
+static const int16_t BiDefaultMatchLengths[BI_ZSTD_ML_SYMBOLS] = {
+    1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static const int16_t BiDefaultOffsets[] = {
+    1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1,
+};
+
+static const uint32_t BiLiteralLengthBase[BI_ZSTD_LL_SYMBOLS] = {
+    0,  1,  2,  3,  4,  5,  6,  7,  8,   9,   10,  11,  12,   13,   14,   15,   16,    18,
+    20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536,
+};
+
+static const uint8_t BiLiteralLengthBits[BI_ZSTD_LL_SYMBOLS] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+};
+
+static const uint32_t BiMatchLengthBase[BI_ZSTD_ML_SYMBOLS] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13,  14,  15,  16,  17,   18,   19,   20,   21,    22,    23,    24,
+    25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35,  37,  39,  41,  43,   47,   51,   59,   67,    83,    99,    131,
+    259, 515, 1027, 2051, 4099, 8195, 16387, 32771, 65539,
+};
+
+static const uint8_t BiMatchLengthBits[BI_ZSTD_ML_SYMBOLS] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+};
+
+// entropy-coded bitstreams are read backwards, starting below the highest set bit of the last byte
+struct BiBitStream {
+    const unsigned char *Data;
+    ssize_t Position;
+};
+
+static void BiInitBitStream(struct BiBitStream *stream, const unsigned char *data, size_t size) {
+    if (size == 0 || data[size - 1] == 0) BlCrash("compressed image contains an invalid bitstream");
+
+    stream->Data = data;
+    stream->Position = (size - 1) * 8 + BiHighBit(data[size - 1]);
+}
+
+// bits before the start of the stream read as zero
+static uint32_t BiPeekBits(struct BiBitStream *stream, unsigned count) {
+    if (stream->Position <= 0 || count == 0) return 0;
+
+    size_t position = stream->Position;
+    unsigned shift = 0;
+
+    if (position < count) {
+        shift = count - position;
+        count = position;
+    }
+
+    size_t start = position - count;
+    uint64_t value = 0;
+
+    for (size_t i = ((position - 1) >> 3) + 1; i > (start >> 3); i--) {
+        value = (value << 8) | stream->Data[i - 1];
+    }
+
+    return (uint32_t)((value >> (start & 7)) & ((1ull << count) - 1)) << shift;
+}
+
+static uint32_t BiReadBits(struct BiBitStream *stream, unsigned count) {
+    uint32_t value = BiPeekBits(stream, count);
+    stream->Position -= count;
+    return value;
+}
+
+// table descriptions are instead read forwards
+static uint32_t BiReadForwardBits(const unsigned char *data, size_t size, size_t position, unsigned count) {
+    uint32_t value = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        size_t bit = position + i;
+        if ((bit >> 3) < size) value |= (uint32_t)((data[bit >> 3] >> (bit & 7)) & 1) << i;
+    }
+
+    return value;
+}
+
+static void BiBuildFseTable(struct BiFseTable *table, const int16_t *counts, size_t symbols, unsigned log) {
+    size_t size = 1u << log;
+    size_t high = size - 1;
+    uint16_t next[BI_ZSTD_HUFFMAN_MAX_SYMBOLS];
+
+    // symbols with a probability of "less than one" take a single cell at the end of the table
+    for (size_t i = 0; i < symbols; i++) {
+        if (counts[i] == -1) {
+            table->Entries[high--].Symbol = i;
+            next[i] = 1;
+        } else {
+            next[i] = counts[i];
+        }
+    }
+
+    size_t step = (size >> 1) + (size >> 3) + 3;
+    size_t position = 0;
+
+    for (size_t i = 0; i < symbols; i++) {
+        for (int j = 0; j < counts[i]; j++) {
+            table->Entries[position].Symbol = i;
+
+            do {
+                position = (position + step) & (size - 1);
+            } while (position > high);
+        }
+    }
+
+    if (position != 0) BlCrash("compressed image contains an invalid fse table");
+
+    for (size_t i = 0; i < size; i++) {
+        struct BiFseEntry *entry = &table->Entries[i];
+        unsigned state = next[entry->Symbol]++;
+
+        entry->Bits = log - BiHighBit(state);
+        entry->Base = (state << entry->Bits) - size;
+    }
+
+    table->Log = log;
+    table->Valid = true;
+}
+
+// reads an fse table description and returns its size in bytes
+static size_t BiReadFseTable(
+    struct BiFseTable *table,
+    const unsigned char *data,
+    size_t size,
+    size_t symbols,
+    unsigned maxLog
+) {
+    int16_t counts[BI_ZSTD_HUFFMAN_MAX_SYMBOLS];
+    size_t position = 4;
+
+    unsigned log = BiReadForwardBits(data, size, 0, 4) + BI_ZSTD_FSE_MIN_LOG;
+    if (log > maxLog) BlCrash("compressed image contains an invalid fse table");
+
+    int remaining = (1 << log) + 1;
+    int threshold = 1 << log;
+    unsigned bits = log + 1;
+    size_t symbol = 0;
+
+    while (remaining > 1) {
+        if (symbol >= symbols) BlCrash("compressed image contains an invalid fse table");
+
+        int max = (2 * threshold - 1) - remaining;
+        int count = BiReadForwardBits(data, size, position, bits - 1);
+
+        if (count < max) {
+            position += bits - 1;
+        } else {
+            count = BiReadForwardBits(data, size, position, bits);
+            if (count >= threshold) count -= max;
+            position += bits;
+        }
+
+        count -= 1;
+        remaining -= count < 0 ? -count : count;
+        counts[symbol++] = count;
+
+        // a zero probability is followed by the number of further zero probabilities
+        if (count == 0) {
+            unsigned repeat;
+
+            do {
+                repeat = BiReadForwardBits(data, size, position, 2);
+                position += 2;
+
+                if (repeat > symbols - symbol) BlCrash("compressed image contains an invalid fse table");
+
+                for (unsigned i = 0; i < repeat; i++) {
+                    counts[symbol++] = 0;
+                }
+            } while (repeat == 3);
+        }
+
+        while (remaining < threshold) {
+            bits -= 1;
+            threshold >>= 1;
+        }
+    }
+
+    size_t length = (position + 7) >> 3;
+    if (remaining != 1 || length > size) BlCrash("compressed image contains an invalid fse table");
+
+    BiBuildFseTable(table, counts, symbol, log);
+    return length;
+}
+
+// reads a huffman tree description and returns its size in bytes
+static size_t BiReadHuffmanTable(struct BiZstd *zstd, const unsigned char *data, size_t size) {
+    if (size == 0) BlCrash("compressed image contains an invalid huffman table");
+
+    uint8_t weights[BI_ZSTD_HUFFMAN_MAX_SYMBOLS];
+    size_t count = 0;
+    size_t header = data[0];
+    size_t length;
+
+    if (header >= 128) {
+        count = header - 127;
+        length = 1 + (count + 1) / 2;
+        if (length > size) BlCrash("compressed image contains an invalid huffman table");
+
+        for (size_t i = 0; i < count; i++) {
+            weights[i] = (data[1 + i / 2] >> ((i & 1) ? 0 : 4)) & 15;
+        }
+    } else {
+        length = 1 + header;
+        if (length > size) BlCrash("compressed image contains an invalid huffman table");
+
+        // the weights are fse compressed with two interleaved states
+        struct BiFseTable *table = &zstd->Weights;
+        size_t tableSize = BiReadFseTable(table, data + 1, header, BI_ZSTD_HUFFMAN_MAX_SYMBOLS, BI_ZSTD_WEIGHT_MAX_LOG);
+        if (tableSize >= header) BlCrash("compressed image contains an invalid huffman table");
+
+        struct BiBitStream stream;
+        BiInitBitStream(&stream, data + 1 + tableSize, header - tableSize);
+
+        unsigned states[2];
+        states[0] = BiReadBits(&stream, table->Log);
+        states[1] = BiReadBits(&stream, table->Log);
+
+        for (size_t i = 0;; i ^= 1) {
+            if (count + 2 > BI_ZSTD_HUFFMAN_MAX_SYMBOLS) BlCrash("compressed image contains an invalid huffman table");
+
+            struct BiFseEntry *entry = &table->Entries[states[i]];
+            weights[count++] = entry->Symbol;
+            states[i] = entry->Base + BiReadBits(&stream, entry->Bits);
+
+            if (stream.Position < 0) {
+                weights[count++] = table->Entries[states[i ^ 1]].Symbol;
+                break;
+            }
+        }
+    }
+
+    // the weight of the last symbol is implied by the others adding up to a power of two
+    uint32_t total = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (weights[i] > BI_ZSTD_HUFFMAN_MAX_BITS) BlCrash("compressed image contains an invalid huffman table");
+        if (weights[i] != 0) total += 1u << (weights[i] - 1);
+    }
+
+    if (total == 0) BlCrash("compressed image contains an invalid huffman table");
+
+    unsigned bits = BiHighBit(total) + 1;
+    uint32_t left = (1u << bits) - total;
+
+    if (bits > BI_ZSTD_HUFFMAN_MAX_BITS || (left & (left - 1)) != 0) {
+        BlCrash("compressed image contains an invalid huffman table");
+    }
+
+    weights[count++] = BiHighBit(left) + 1;
+
+    // codes are assigned in order of increasing weight, so each weight owns a contiguous range of the table
+    uint32_t starts[BI_ZSTD_HUFFMAN_MAX_BITS + 1] = {};
+
+    for (size_t i = 0; i < count; i++) {
+        starts[weights[i]] += 1;
+    }
+
+    uint32_t next = 0;
+
+    for (unsigned weight = 1; weight <= bits; weight++) {
+        uint32_t current = starts[weight] << (weight - 1);
+        starts[weight] = next;
+        next += current;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        unsigned weight = weights[i];
+        if (weight == 0) continue;
+
+        uint16_t entry = i | ((bits + 1 - weight) << 8);
+
+        for (size_t j = 0; j < (1u << (weight - 1)); j++) {
+            zstd->Huffman[starts[weight]++] = entry;
+        }
+    }
+
+    zstd->HuffmanBits = bits;
+    zstd->HuffmanValid = true;
+    return length;
+}
+
+static void BiDecodeHuffmanStream(
+    struct BiZstd *zstd,
+    unsigned char *buffer,
+    size_t count,
+    const unsigned char *data,
+    size_t size
+) {
+    struct BiBitStream stream;
+    BiInitBitStream(&stream, data, size);
+
+    for (size_t i = 0; i < count; i++) {
+        uint16_t entry = zstd->Huffman[BiPeekBits(&stream, zstd->HuffmanBits)];
+
+        buffer[i] = entry;
+        stream.Position -= entry >> 8;
+    }
+
+    if (stream.Position != 0) BlCrash("compressed image contains invalid literals");
+}
+
+// reads the literals section of a block and returns its size in bytes
+static size_t BiReadLiterals(
+    struct BlDecompressor *dec,
+    const unsigned char *data,
+    size_t size,
+    const unsigned char **literals,
+    size_t *literalCount
+) {
+    struct BiZstd *zstd = &dec->Zstd;
+    if (size == 0) BlCrash("compressed image contains invalid literals");
+
+    unsigned type = data[0] & 3;
+    unsigned format = (data[0] >> 2) & 3;
+
+    if (type < 2) {
+        size_t header;
+        size_t count;
+
+        switch (format) {
+        case 1:
+            header = 2;
+            if (size < header) BlCrash("compressed image contains invalid literals");
+            count = (data[0] >> 4) | (data[1] << 4);
+            break;
+        case 3:
+            header = 3;
+            if (size < header) BlCrash("compressed image contains invalid literals");
+            count = (data[0] >> 4) | (data[1] << 4) | (data[2] << 12);
+            break;
+        default: header = 1; count = data[0] >> 3; break;
+        }
+
+        if (count > zstd->BlockMax) BlCrash("compressed image contains invalid literals");
+
+        *literalCount = count;
+
+        if (type == 0) {
+            if (size - header < count) BlCrash("compressed image contains invalid literals");
+
+            *literals = data + header;
+            return header + count;
+        } else {
+            if (size == header) BlCrash("compressed image contains invalid literals");
+
+            BlFillMemory(zstd->Literals, data[header], count);
+            *literals = zstd->Literals;
+            return header + 1;
+        }
+    }
+
+    size_t header = format < 2 ? 3 : format + 2;
+    unsigned bits = format < 2 ? 10 : 6 + format * 4;
+    if (size < header) BlCrash("compressed image contains invalid literals");
+
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < header; i++) {
+        value |= (uint64_t)data[i] << (i * 8);
+    }
+
+    size_t count = (value >> 4) & ((1u << bits) - 1);
+    size_t compressed = (value >> (4 + bits)) & ((1u << bits) - 1);
+
+    if (count > zstd->BlockMax || size - header < compressed) BlCrash("compressed image contains invalid literals");
+
+    const unsigned char *current = data + header;
+    size_t left = compressed;
+
+    // treeless literals reuse the previous block's huffman table
+    if (type == 2) {
+        size_t tableSize = BiReadHuffmanTable(zstd, current, left);
+        current += tableSize;
+        left -= tableSize;
+    } else if (!zstd->HuffmanValid) {
+        BlCrash("compressed image contains invalid literals");
+    }
+
+    if (format == 0) {
+        BiDecodeHuffmanStream(zstd, zstd->Literals, count, current, left);
+    } else {
+        if (left < 6) BlCrash("compressed image contains invalid literals");
+
+        size_t sizes[4];
+        size_t total = 6;
+
+        for (size_t i = 0; i < 3; i++) {
+            sizes[i] = current[i * 2] | (current[i * 2 + 1] << 8);
+            total += sizes[i];
+        }
+
+        size_t perStream = (count + 3) / 4;
+        if (total > left || count < perStream * 3) BlCrash("compressed image contains invalid literals");
+
+        sizes[3] = left - total;
+        current += 6;
+
+        for (size_t i = 0; i < 4; i++) {
+            size_t streamCount = i < 3 ? perStream : count - perStream * 3;
+
+            BiDecodeHuffmanStream(zstd, zstd->Literals + perStream * i, streamCount, current, sizes[i]);
+            current += sizes[i];
+        }
+    }
+
+    *literals = zstd->Literals;
+    *literalCount = count;
+    return header + compressed;
+}
+
+static void BiReadSequenceTable(
+    struct BiFseTable *table,
+    unsigned mode,
+    const unsigned char *data,
+    size_t size,
+    size_t *position,
+    const int16_t *defaults,
+    size_t defaultCount,
+    unsigned defaultLog,
+    size_t symbols,
+    unsigned maxLog
+) {
+    switch (mode) {
+    case 0: BiBuildFseTable(table, defaults, defaultCount, defaultLog); break;
+    case 1:
+        if (*position >= size || data[*position] >= symbols) BlCrash("compressed image contains invalid sequences");
+
+        table->Entries[0].Symbol = data[(*position)++];
+        table->Entries[0].Bits = 0;
+        table->Entries[0].Base = 0;
+        table->Log = 0;
+        table->Valid = true;
+        break;
+    case 2: *position += BiReadFseTable(table, data + *position, size - *position, symbols, maxLog); break;
+    case 3:
+        if (!table->Valid) BlCrash("compressed image contains invalid sequences");
+        break;
+    }
+}
+
+static size_t BiResolveOffset(struct BiZstd *zstd, uint32_t value, size_t literalLength) {
+    size_t *repeat = zstd->RepeatOffsets;
+
+    if (value > 3) {
+        repeat[2] = repeat[1];
+        repeat[1] = repeat[0];
+        repeat[0] = value - 3;
+        return repeat[0];
+    }
+
+    // repeat codes are shifted by one when there are no literals
+    size_t index = value - 1 + (literalLength == 0);
+    if (index == 0) return repeat[0];
+
+    size_t offset = index == 3 ? repeat[0] - 1 : repeat[index];
+
+    if (index > 1) repeat[2] = repeat[1];
+    repeat[1] = repeat[0];
+    repeat[0] = offset;
+    return offset;
+}
+
+static void BiExecuteSequences(
+    struct BlDecompressor *dec,
+    const unsigned char *data,
+    size_t size,
+    const unsigned char *literals,
+    size_t literalCount
+) {
+    struct BiZstd *zstd = &dec->Zstd;
+    size_t limit = dec->Head + zstd->BlockMax;
+
+    if (size == 0) BlCrash("compressed image contains invalid sequences");
+
+    size_t count = data[0];
+    size_t position = 1;
+
+    if (count == 255) {
+        if (size < 3) BlCrash("compressed image contains invalid sequences");
+        count = data[1] + (data[2] << 8) + 0x7f00;
+        position = 3;
+    } else if (count >= 128) {
+        if (size < 2) BlCrash("compressed image contains invalid sequences");
+        count = ((count - 128) << 8) + data[1];
+        position = 2;
+    }
+
+    if (count != 0) {
+        if (position >= size) BlCrash("compressed image contains invalid sequences");
+
+        unsigned modes = data[position++];
+        if (modes & 3) BlCrash("compressed image contains invalid sequences");
+
+        BiReadSequenceTable(
+            &zstd->LiteralLengths,
+            modes >> 6,
+            data,
+            size,
+            &position,
+            BiDefaultLiteralLengths,
+            BL_ARRAY_SIZE(BiDefaultLiteralLengths),
+            6,
+            BI_ZSTD_LL_SYMBOLS,
+            BI_ZSTD_LL_MAX_LOG
+        );
+        BiReadSequenceTable(
+            &zstd->Offsets,
+            (modes >> 4) & 3,
+            data,
+            size,
+            &position,
+            BiDefaultOffsets,
+            BL_ARRAY_SIZE(BiDefaultOffsets),
+            5,
+            BI_ZSTD_OF_SYMBOLS,
+            BI_ZSTD_OF_MAX_LOG
+        );
+        BiReadSequenceTable(
+            &zstd->MatchLengths,
+            (modes >> 2) & 3,
+            data,
+            size,
+            &position,
+            BiDefaultMatchLengths,
+            BL_ARRAY_SIZE(BiDefaultMatchLengths),
+            6,
+            BI_ZSTD_ML_SYMBOLS,
+            BI_ZSTD_ML_MAX_LOG
+        );
+
+        struct BiBitStream stream;
+        BiInitBitStream(&stream, data + position, size - position);
+
+        unsigned literalState = BiReadBits(&stream, zstd->LiteralLengths.Log);
+        unsigned offsetState = BiReadBits(&stream, zstd->Offsets.Log);
+        unsigned matchState = BiReadBits(&stream, zstd->MatchLengths.Log);
+
+        for (size_t i = 0; i < count; i++) {
+            struct BiFseEntry *literalEntry = &zstd->LiteralLengths.Entries[literalState];
+            struct BiFseEntry *offsetEntry = &zstd->Offsets.Entries[offsetState];
+            struct BiFseEntry *matchEntry = &zstd->MatchLengths.Entries[matchState];
+
+            uint32_t offsetValue = (1u << offsetEntry->Symbol) + BiReadBits(&stream, offsetEntry->Symbol);
+            size_t matchLength = BiMatchLengthBase[matchEntry->Symbol] +
+                                 BiReadBits(&stream, BiMatchLengthBits[matchEntry->Symbol]);
+            size_t literalLength = BiLiteralLengthBase[literalEntry->Symbol] +
+                                   BiReadBits(&stream, BiLiteralLengthBits[literalEntry->Symbol]);
+
+            size_t offset = BiResolveOffset(zstd, offsetValue, literalLength);
+
+            if (i + 1 != count) {
+                literalState = literalEntry->Base + BiReadBits(&stream, literalEntry->Bits);
+                matchState = matchEntry->Base + BiReadBits(&stream, matchEntry->Bits);
+                offsetState = offsetEntry->Base + BiReadBits(&stream, offsetEntry->Bits);
+            }
+
+            if (literalLength > literalCount || limit - dec->Head < literalLength + matchLength) {
+                BlCrash("compressed image contains invalid sequences");
+            }
+
+            BlCopyMemory(dec->Buffer + dec->Head, literals, literalLength);
+            dec->Head += literalLength;
+            literals += literalLength;
+            literalCount -= literalLength;
+
+            BiCopyMatch(dec, offset, matchLength);
+        }
+
+        if (stream.Position != 0) BlCrash("compressed image contains invalid sequences");
+    }
+
+    if (limit - dec->Head < literalCount) BlCrash("compressed image contains invalid sequences");
+
+    BlCopyMemory(dec->Buffer + dec->Head, literals, literalCount);
+    dec->Head += literalCount;
+}
+
+static void BiZstdReadFrameHeader(struct BlDecompressor *dec) {
+    struct BiZstd *zstd = &dec->Zstd;
+
+    while (true) {
+        uint32_t magic = BiInputLe32(dec);
+        if (magic == BI_ZSTD_MAGIC) break;
+        if ((magic & BI_SKIPPABLE_MASK) != BI_SKIPPABLE_MAGIC) BlCrash("invalid zstd frame header");
+
+        BiSkipInput(dec, BiInputLe32(dec));
+    }
+
+    uint8_t descriptor = BiInputByte(dec);
+    if (descriptor & BI_ZSTD_RESERVED) BlCrash("invalid zstd frame header");
+
+    uint64_t windowSize = 0;
+
+    if (!(descriptor & BI_ZSTD_SINGLE_SEGMENT)) {
+        uint8_t window = BiInputByte(dec);
+        unsigned log = BI_ZSTD_MIN_WINDOW_LOG + (window >> 3);
+        if (log > BI_ZSTD_MAX_WINDOW_LOG) BlCrash("zstd window is too large");
+
+        uint32_t base = 1u << log;
+        windowSize = base + (base >> 3) * (window & 7);
+    }
+
+    static const uint8_t dictIdSizes[] = {0, 1, 2, 4};
+    static const uint8_t contentSizeSizes[] = {0, 2, 4, 8};
+
+    if (BiInputLe(dec, dictIdSizes[descriptor & 3]) != 0) BlCrash("zstd dictionaries are not supported");
+
+    size_t sizeBytes = contentSizeSizes[descriptor >> 6];
+    if (sizeBytes == 0 && (descriptor & BI_ZSTD_SINGLE_SEGMENT)) sizeBytes = 1;
+
+    if (sizeBytes != 0) {
+        uint64_t contentSize = BiInputLe(dec, sizeBytes);
+        if (sizeBytes == 2) contentSize += 256;
+        if (dec->SizeHint == 0) dec->SizeHint = contentSize;
+
+        // single segment frames must be decoded in one go, so the window covers the whole frame
+        if (descriptor & BI_ZSTD_SINGLE_SEGMENT) {
+            if (contentSize > (1ull << BI_ZSTD_MAX_WINDOW_LOG)) BlCrash("zstd window is too large");
+            windowSize = contentSize;
+        }
+    }
+
+    windowSize = BL_MAX(windowSize, (uint64_t)1 << BI_ZSTD_MIN_WINDOW_LOG);
+    if (dec->Buffer && windowSize > dec->WindowSize) BlCrash("zstd frame needs a larger window than the first frame");
+
+    zstd->WindowSize = windowSize;
+    zstd->BlockMax = BL_MIN(windowSize, (uint64_t)BI_ZSTD_BLOCK_MAX);
+    zstd->Checksum = descriptor & BI_ZSTD_CHECKSUM;
+    BlXxh64Init(&zstd->Hash);
+    zstd->LastBlock = false;
+    zstd->RepeatOffsets[0] = 1;
+    zstd->RepeatOffsets[1] = 4;
+    zstd->RepeatOffsets[2] = 8;
+    zstd->HuffmanValid = false;
+    zstd->LiteralLengths.Valid = false;
+    zstd->MatchLengths.Valid = false;
+    zstd->Offsets.Valid = false;
+}
+
+static void BiZstdStep(struct BlDecompressor *dec) {
+    struct BiZstd *zstd = &dec->Zstd;
+
+    if (zstd->LastBlock) {
+        BiUpdateChecksum(dec);
+
+        // the frame only stores the low 32 bits of the hash
+        if (zstd->Checksum && BiInputLe32(dec) != (uint32_t)BlXxh64Finish(&zstd->Hash)) {
+            BlCrash("zstd frame has the wrong checksum");
+        }
+
+        if (BiInputAtEnd(dec)) {
+            dec->Finished = true;
+        } else {
+            BiZstdReadFrameHeader(dec);
+        }
+
+        return;
+    }
+
+    uint32_t header = BiInputByte(dec);
+    header |= BiInputByte(dec) << 8;
+    header |= BiInputByte(dec) << 16;
+
+    size_t size = header >> 3;
+    zstd->LastBlock = header & 1;
+
+    if (size > zstd->BlockMax) BlCrash("compressed image contains an invalid zstd block");
+
+    switch ((header >> 1) & 3) {
+    case 0:
+        BiInputCopy(dec, dec->Buffer + dec->Head, size);
+        dec->Head += size;
+        break;
+    case 1:
+        BlFillMemory(dec->Buffer + dec->Head, BiInputByte(dec), size);
+        dec->Head += size;
+        break;
+    case 2: {
+        BiRequireInput(dec, size);
+
+        // the literals may point into the input buffer, which stays intact until the block is done
+        const unsigned char *data = dec->Input + dec->InputHead;
+        dec->InputHead += size;
+
+        const unsigned char *literals;
+        size_t literalCount;
+        size_t literalsSize = BiReadLiterals(dec, data, size, &literals, &literalCount);
+
+        BiExecuteSequences(dec, data + literalsSize, size - literalsSize, literals, literalCount);
+        break;
+    }
+    default: BlCrash("compressed image contains an invalid zstd block");
+    }
+}
+
+static void BiDecompressStep(struct BlDecompressor *dec) {
+    switch (dec->Format) {
+    case BI_FORMAT_GZIP: BiInflateStep(dec); break;
+    case BI_FORMAT_LZ4: BiLz4Step(dec); break;
+    case BI_FORMAT_ZSTD: BiZstdStep(dec); break;
+    }
+}
+
+struct BlDecompressor *BlDecompressOpen(struct BlFsFile *file) {
+    uint64_t fileSize = BlFsFileSize(file);
+    if (fileSize < sizeof(uint32_t)) return nullptr;
+
+    uint32_t magic;
+    BlFsFileRead(file, &magic, sizeof(magic), 0, false);
+    magic = BL_LE32(magic);
+
+    enum BiFormat format;
+
+    if ((magic & 0xffff) == BI_GZIP_MAGIC) {
+        format = BI_FORMAT_GZIP;
+    } else if (magic == BI_LZ4_MAGIC) {
+        format = BI_FORMAT_LZ4;
+    } else if (magic == BI_ZSTD_MAGIC) {
+        format = BI_FORMAT_ZSTD;
+    } else {
+        return nullptr;
+    }
+
+    struct BlDecompressor *dec = BL_ALLOCATE(struct BlDecompressor, 1);
+    BlFillMemory(dec, 0, sizeof(*dec));
+
+    dec->File = file;
+    dec->FileSize = fileSize;
+    dec->Format = format;
+    dec->InputCapacity = BI_INPUT_SIZE + BL_SECTOR_SIZE;
+    dec->Input = BlAllocateHeap(dec->InputCapacity, BL_SECTOR_SIZE, false);
+
+    switch (format) {
+    case BI_FORMAT_GZIP: {
+        BiGzipReadHeader(dec);
+
+        // the last member ends with its decompressed size
+        uint32_t size;
+        BlFsFileRead(file, &size, sizeof(size), fileSize - sizeof(size), false);
+        dec->SizeHint = BL_LE32(size);
+
+        dec->WindowSize = BI_INFLATE_WINDOW;
+        dec->Unit = BI_INFLATE_MAX_MATCH;
+        break;
+    }
+    case BI_FORMAT_LZ4:
+        BiLz4ReadFrameHeader(dec);
+        dec->WindowSize = BI_LZ4_WINDOW;
+        dec->Unit = 1;
+        break;
+    case BI_FORMAT_ZSTD:
+        BiZstdReadFrameHeader(dec);
+        dec->WindowSize = dec->Zstd.WindowSize;
+        dec->Unit = BI_ZSTD_BLOCK_MAX;
+        dec->Zstd.Literals = BlAllocateHeap(BI_ZSTD_BLOCK_MAX, 1, false);
+        break;
+    }
+
+    size_t slack = BL_MAX(BL_MIN(dec->WindowSize, (size_t)BI_MAX_SLACK), (size_t)BI_MIN_SLACK);
+    dec->BufferSize = dec->WindowSize + BL_MAX(slack, dec->Unit);
+    dec->Buffer = BlAllocateHeap(dec->BufferSize, 1, false);
+
+    return dec;
+}
+
+uint64_t BlDecompressedSizeHint(struct BlDecompressor *dec) {
+    return dec->SizeHint;
+}
+
+size_t BlDecompressRead(struct BlDecompressor *dec, void *buffer, size_t count) {
+    size_t total = 0;
+
+    while (total < count) {
+        if (dec->Tail == dec->Head) {
+            if (dec->Finished) break;
+
+            if (dec->BufferSize - dec->Head < dec->Unit) {
+                // recycle the buffer, keeping the window that later output may copy from
+                size_t keep = BL_MIN(dec->Head, dec->WindowSize);
+                BiUpdateChecksum(dec);
+
+                BlCopyMemoryOverlapping(dec->Buffer, dec->Buffer + dec->Head - keep, keep);
+                dec->Head = keep;
+                dec->Tail = keep;
+                dec->Checked = keep;
+            }
+
+            BiDecompressStep(dec);
+            continue;
+        }
+
+        size_t current = BL_MIN(dec->Head - dec->Tail, count - total);
+        BlCopyMemory(buffer + total, dec->Buffer + dec->Tail, current);
+
+        dec->Tail += current;
+        total += current;
+    }
+
+    return total;
+}
+
+void BlDecompressClose(struct BlDecompressor *dec) {
+    if (dec->Format == BI_FORMAT_ZSTD) BlFreeHeap(dec->Zstd.Literals);
+
+    BlFreeHeap(dec->Buffer);
+    BlFreeHeap(dec->Input);
+    BlFreeHeap(dec);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "filesystem.h"
+#include <stddef.h>
+#include <stdint.h>
+
+struct BlDecompressor;
+
+// Returns nullptr if the file isn't a gzip, LZ4 frame or zstd image.
+struct BlDecompressor *BlDecompressOpen(struct BlFsFile *file);
+
+// The decompressed size recorded in the image, or 0 if it isn't known. This is only a hint; the data may be longer.
+uint64_t BlDecompressedSizeHint(struct BlDecompressor *decompressor);
+
+// Decompresses the next `count` bytes of the image. Returns less than `count` only at the end of the image.
+size_t BlDecompressRead(struct BlDecompressor *decompressor, void *buffer, size_t count);
+
+void BlDecompressClose(struct BlDecompressor *decompressor);
@@ -14,16 +14,17 @@ struct BlDtRsvMem {
     uint64_t Size;
 };
 
-struct BlDtString {
-    struct BlListNode Node;
-    char *Data;
-    uint32_t Identifier;
+struct BiBootRange {
+    uint64_t Start;
+    uint64_t End;
 };
 
 struct BlDtProperty {
-    struct BlDtString *Name;
+    struct BlDtProperty *Next;
     void *Data;
+    void *BlobData;
     uint32_t Size;
+    uint32_t NameOffset;
 };
 
 struct BlDtNode {
@@ -32,7 +33,7 @@ struct BlDtNode {
     char *Name;
     struct BlList Children;
     struct BlDtProperty *Properties;
-    size_t NumberOfProperties;
+    struct BlDtProperty *LastProperty;
 };
 
 #define BL_DT_NODE_SIZE(nameLength) (8 + BL_ALIGN_UP((nameLength) + 1, 4))
@@ -41,10 +42,27 @@ struct BlDtNode {
 static struct BlDtRsvMem *BlDtRsvMem;
 static size_t BlDtRsvMemCount;
 
-static struct BlList *BlDtStrings;
-static size_t BlDtStringsCount;
-static size_t BlDtStringsCapacity;
+// sorted, and never touching or overlapping each other
+static struct BiBootRange *BiBootRanges;
+static size_t BiBootRangeCount;
+
+// Nodes, properties and their data live until the kernel is started, so they're bump allocated out of large heap
+// blocks instead of getting a heap allocation each.
+#define BI_ARENA_MIN_BLOCK 0x1000u
+#define BI_ARENA_MAX_BLOCK 0x10000u
+
+static unsigned char *BiArenaPos;
+static size_t BiArenaLeft;
+static size_t BiArenaNextBlock = BI_ARENA_MIN_BLOCK;
+
+// The strings block is built as strings are first used, so it can be copied into the blob as is. The table holds
+// offsets into it plus one, with zero marking free slots.
+static char *BlDtStrings;
 static size_t BlDtStringsSize;
+static size_t BlDtStringsCapacity;
+static uint32_t *BiStringTable;
+static size_t BiStringTableCapacity;
+static size_t BiStringCount;
 
 static struct BlDtNode BlDtRootNode = {.Name = ""};
 static size_t BlDtStructureSize = 16; // FDT_BEGIN_NODE("") [8], FDT_END_NODE [4], FDT_END [4]
@@ -61,56 +79,79 @@ static uint32_t BlDtHash(const char *str) {
     return hash;
 }
 
+static void *BiArenaAllocate(size_t size, size_t alignment) {
+    size_t padding = -(uintptr_t)BiArenaPos & (alignment - 1);
+
+    if (padding + size > BiArenaLeft) {
+        // the blocks grow so that big trees don't need many of them, and whatever is left of the old one is lost
+        size_t blockSize = BL_MAX(BiArenaNextBlock, size);
+        BiArenaPos = BlAllocateHeap(blockSize, alignment, false);
+        BiArenaLeft = blockSize;
+        BiArenaNextBlock = BL_MIN(BiArenaNextBlock * 2, BI_ARENA_MAX_BLOCK);
+        padding = 0;
+    }
+
+    void *ptr = BiArenaPos + padding;
+    BiArenaPos += padding + size;
+    BiArenaLeft -= padding + size;
+    return ptr;
+}
+
+#define BI_ARENA_ALLOCATE(type, count) ((type *)BiArenaAllocate(sizeof(type) * (count), _Alignof(type)))
+
 static char *BlDuplicateString(const char *str) {
     size_t len = BlStringLength(str);
-    auto mem = BL_ALLOCATE(char, len + 1);
+    auto mem = BI_ARENA_ALLOCATE(char, len + 1);
     BlCopyMemory(mem, str, len + 1);
     return mem;
 }
 
-static struct BlDtString *BlDtGetString(const char *str) {
-    uint32_t hash = BlDtHash(str);
+static void BiGrowStringTable(void) {
+    size_t newCapacity = BiStringTableCapacity ? BiStringTableCapacity * 2 : 64;
+    auto newTable = BL_ALLOCATE(uint32_t, newCapacity);
+    BlFillMemory(newTable, 0, newCapacity * sizeof(*newTable));
 
-    if (BlDtStringsCount) {
-        size_t bucket = hash & (BlDtStringsCapacity - 1);
+    for (size_t i = 0; i < BiStringTableCapacity; i++) {
+        uint32_t entry = BiStringTable[i];
+        if (!entry) continue;
 
-        BL_LIST_FOREACH(BlDtStrings[bucket], struct BlDtString, Node, entry) {
-            if (BlCompareStrings(entry->Data, str) == 0) {
-                return entry;
-            }
-        }
+        size_t slot = BlDtHash(&BlDtStrings[entry - 1]) & (newCapacity - 1);
+        while (newTable[slot]) slot = (slot + 1) & (newCapacity - 1);
+        newTable[slot] = entry;
     }
 
-    if (BlDtStringsCount >= (BlDtStringsCapacity - (BlDtStringsCapacity / 4))) {
-        size_t newCapacity = BlDtStringsCapacity ? BlDtStringsCapacity * 2 : 8;
-        auto newTable = BL_ALLOCATE(struct BlList, newCapacity);
-        BlFillMemory(newTable, 0, newCapacity * sizeof(*newTable));
+    BlFreeHeap(BiStringTable);
+    BiStringTable = newTable;
+    BiStringTableCapacity = newCapacity;
+}
 
-        for (size_t i = 0; i < BlDtStringsCapacity; i++) {
-            struct BlDtString *cur = BL_LIST_HEAD(struct BlDtString, Node, BlDtStrings[i]);
+// returns the offset of the string in the strings block, adding it if it isn't there yet
+static uint32_t BlDtGetString(const char *str) {
+    if (BiStringCount >= BiStringTableCapacity - (BiStringTableCapacity / 4)) BiGrowStringTable();
 
-            while (cur) {
-                struct BlDtString *next = BL_LIST_NEXT(struct BlDtString, Node, *cur);
-                size_t newBucket = BlDtHash(cur->Data) & (newCapacity - 1);
-                BlListInsertAfter(&newTable[newBucket], nullptr, &cur->Node);
-                cur = next;
-            }
-        }
+    size_t slot = BlDtHash(str) & (BiStringTableCapacity - 1);
 
-        BlFreeHeap(BlDtStrings);
-        BlDtStrings = newTable;
-        BlDtStringsCapacity = newCapacity;
+    while (BiStringTable[slot]) {
+        uint32_t offset = BiStringTable[slot] - 1;
+        if (BlCompareStrings(&BlDtStrings[offset], str) == 0) return offset;
+        slot = (slot + 1) & (BiStringTableCapacity - 1);
     }
 
-    auto entry = BL_ALLOCATE(struct BlDtString, 1);
-    entry->Data = BlDuplicateString(str);
+    size_t size = BlStringLength(str) + 1;
 
-    size_t bucket = hash & (BlDtStringsCapacity - 1);
-    BlListInsertAfter(&BlDtStrings[bucket], nullptr, &entry->Node);
-    BlDtStringsCount += 1;
-    BlDtStringsSize += BlStringLength(str) + 1;
+    if (BlDtStringsSize + size > BlDtStringsCapacity) {
+        BlDtStringsCapacity = BL_MAX(BlDtStringsCapacity * 2, BlDtStringsSize + size);
+        BlDtStrings = BL_RESIZE(char, BlDtStrings, BlDtStringsCapacity);
+    }
+
+    uint32_t offset = BlDtStringsSize;
+    BlCopyMemory(&BlDtStrings[offset], str, size);
+    BlDtStringsSize += size;
+
+    BiStringTable[slot] = offset + 1;
+    BiStringCount += 1;
 
-    return entry;
+    return offset;
 }
 
 void BlDtAddReservedMemory(uint64_t base, uint64_t size) {
@@ -121,15 +162,56 @@ void BlDtAddReservedMemory(uint64_t base, uint64_t size) {
     BlDtRsvMem[index].Size = size;
 }
 
+void BlDtReserveBootMemory(uint64_t base, uint64_t size) {
+    uint64_t end = base + size;
+    size_t low = 0;
+    size_t high = BiBootRangeCount;
+
+    // find the first range that starts after `base`
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+
+        if (BiBootRanges[mid].Start <= base) low = mid + 1;
+        else high = mid;
+    }
+
+    size_t index = low;
+
+    if (index > 0 && BiBootRanges[index - 1].End >= base) {
+        index -= 1;
+        if (BiBootRanges[index].End < end) BiBootRanges[index].End = end;
+    } else {
+        BiBootRanges = BL_RESIZE(struct BiBootRange, BiBootRanges, BiBootRangeCount + 1);
+        BlCopyMemoryOverlapping(&BiBootRanges[index + 1], &BiBootRanges[index], (BiBootRangeCount - index) * sizeof(*BiBootRanges));
+        BiBootRanges[index].Start = base;
+        BiBootRanges[index].End = end;
+        BiBootRangeCount += 1;
+    }
+
+    // absorb the ranges that the grown range now reaches
+    struct BiBootRange *range = &BiBootRanges[index];
+    size_t next = index + 1;
+
+    while (next < BiBootRangeCount && BiBootRanges[next].Start <= range->End) {
+        if (range->End < BiBootRanges[next].End) range->End = BiBootRanges[next].End;
+        next += 1;
+    }
+
+    if (next != index + 1) {
+        BlCopyMemoryOverlapping(range + 1, &BiBootRanges[next], (BiBootRangeCount - next) * sizeof(*BiBootRanges));
+        BiBootRangeCount -= next - (index + 1);
+    }
+}
+
 struct BlDtNode *BlDtCreateNode(struct BlDtNode *parent, const char *name) {
     if (!parent) parent = &BlDtRootNode;
 
-    auto node = BL_ALLOCATE(struct BlDtNode, 1);
+    auto node = BI_ARENA_ALLOCATE(struct BlDtNode, 1);
     node->Parent = parent;
     node->Name = BlDuplicateString(name);
     BlListInit(&node->Children);
     node->Properties = nullptr;
-    node->NumberOfProperties = 0;
+    node->LastProperty = nullptr;
 
     BlListInsertBefore(&parent->Children, nullptr, &node->Node);
     BlDtStructureSize += BL_DT_NODE_SIZE(BlStringLength(node->Name));
@@ -137,26 +219,33 @@ struct BlDtNode *BlDtCreateNode(struct BlDtNode *parent, const char *name) {
     return node;
 }
 
-static void BlDtDoAddProperty(struct BlDtNode *parent, const char *name, void *data, uint32_t size) {
+// `data` must come from the arena
+static struct BlDtProperty *BlDtDoAddProperty(struct BlDtNode *parent, const char *name, void *data, uint32_t size) {
     if (!parent) parent = &BlDtRootNode;
 
-    size_t index = parent->NumberOfProperties++;
-    parent->Properties = BL_RESIZE(struct BlDtProperty, parent->Properties, parent->NumberOfProperties);
-    parent->Properties[index].Name = BlDtGetString(name);
-    parent->Properties[index].Data = data;
-    parent->Properties[index].Size = size;
+    auto property = BI_ARENA_ALLOCATE(struct BlDtProperty, 1);
+    property->Next = nullptr;
+    property->Data = data;
+    property->BlobData = nullptr;
+    property->Size = size;
+    property->NameOffset = BlDtGetString(name);
+
+    if (parent->LastProperty) parent->LastProperty->Next = property;
+    else parent->Properties = property;
+    parent->LastProperty = property;
 
     BlDtStructureSize += BL_DT_PROP_SIZE(size);
+    return property;
 }
 
 void BlDtAddProperty(struct BlDtNode *parent, const char *name, const void *data, uint32_t size) {
-    void *buffer = BL_ALLOCATE(unsigned char, size);
+    void *buffer = BI_ARENA_ALLOCATE(unsigned char, size);
     BlCopyMemory(buffer, data, size);
     BlDtDoAddProperty(parent, name, buffer, size);
 }
 
 void BlDtAddPropertyU32s(struct BlDtNode *parent, const char *name, const uint32_t *data, uint32_t count) {
-    auto buffer = BL_ALLOCATE(uint32_t, count);
+    auto buffer = BI_ARENA_ALLOCATE(uint32_t, count);
 
     for (uint32_t i = 0; i < count; i++) {
         buffer[i] = BL_BE32(data[i]);
@@ -169,7 +258,7 @@ void BlDtAddPropertyStrings(struct BlDtNode *parent, const char *name, const cha
     size_t size = 0;
     for (size_t i = 0; i < count; i++) size += BlStringLength(data[i]) + 1;
 
-    void *buffer = BL_ALLOCATE(unsigned char, size);
+    void *buffer = BI_ARENA_ALLOCATE(unsigned char, size);
     size = 0;
 
     for (size_t i = 0; i < count; i++) {
@@ -194,6 +283,78 @@ struct BlDtNode *BlDtFindNode(struct BlDtNode *parent, const char *name) {
     return nullptr;
 }
 
+static struct BlDtProperty *BiFindProperty(struct BlDtNode *node, const char *name) {
+    for (auto property = node->Properties; property != nullptr; property = property->Next) {
+        if (BlCompareStrings(&BlDtStrings[property->NameOffset], name) == 0) {
+            return property;
+        }
+    }
+
+    return nullptr;
+}
+
+// returns the #address-cells or #size-cells of `node`, or the default the spec gives for a missing one
+static uint32_t BiGetCellCount(struct BlDtNode *node, const char *name, uint32_t fallback) {
+    auto property = BiFindProperty(node, name);
+    if (!property) return fallback;
+
+    if (property->Size != sizeof(uint32_t)) BlCrash("BiGetCellCount: invalid `%s`", name);
+    return BL_BE32(*(uint32_t *)property->Data);
+}
+
+static uint32_t *BiEncodeCells(uint32_t *cells, uint64_t value, uint32_t count) {
+    if (count < 2 && (value >> 32) != 0) BlCrash("BiEncodeCells: value does not fit in %u cells", count);
+
+    for (uint32_t i = count; i > 0; i--) {
+        cells[i - 1] = BL_BE32((uint32_t)value);
+        value >>= 32;
+    }
+
+    return cells + count;
+}
+
+void BlDtAddPropertyReg(struct BlDtNode *node, const uint64_t *data, size_t count) {
+    uint32_t addressCells = BiGetCellCount(node->Parent, "#address-cells", 2);
+    uint32_t sizeCells = BiGetCellCount(node->Parent, "#size-cells", 1);
+    auto buffer = BI_ARENA_ALLOCATE(uint32_t, count * (addressCells + sizeCells));
+    auto cursor = buffer;
+
+    for (size_t i = 0; i < count; i++) {
+        cursor = BiEncodeCells(cursor, data[i * 2], addressCells);
+        cursor = BiEncodeCells(cursor, data[i * 2 + 1], sizeCells);
+    }
+
+    BlDtDoAddProperty(node, "reg", buffer, (void *)cursor - (void *)buffer);
+}
+
+struct BlDtNode *BlDtGetReservedMemoryNode(void) {
+    auto node = BlDtFindNode(nullptr, "reserved-memory");
+    if (node) return node;
+
+    node = BlDtCreateNode(nullptr, "reserved-memory");
+
+    // the spec requires these to match the root node, and a missing one already does
+    static const char *const cellNames[] = {"#address-cells", "#size-cells"};
+
+    for (size_t i = 0; i < BL_ARRAY_SIZE(cellNames); i++) {
+        auto property = BiFindProperty(&BlDtRootNode, cellNames[i]);
+        if (property) BlDtAddProperty(node, cellNames[i], property->Data, property->Size);
+    }
+
+    BlDtAddProperty(node, "ranges", nullptr, 0);
+    return node;
+}
+
+void *BlDtGetBlobProperty(struct BlDtNode *node, const char *name) {
+    if (!node) node = &BlDtRootNode;
+
+    auto property = BiFindProperty(node, name);
+    if (!property) BlCrash("BlDtGetBlobProperty: no property `%s`", name);
+
+    BL_ASSERT(property->BlobData != nullptr);
+    return property->BlobData;
+}
+
 const char *BlDtNodeName(struct BlDtNode *node) {
     return node->Name;
 }
@@ -254,45 +415,89 @@ struct BlFdtRsvmapEntry {
 #define BL_FDT_PROP 3
 #define BL_FDT_END 9
 
-static void BlDtAddDataAndAlign(void *structure, size_t *offset, const void *data, size_t size) {
-    size_t aligned = BL_ALIGN_UP(size, 4);
-    size_t curOff = *offset;
-    size_t newOff = curOff + aligned;
-    BL_ASSERT(newOff <= BlDtStructureSize);
+// The structure block is written front to back through a cursor. Its size is known up front, so the bounds are only
+// checked once it's complete.
+static uint32_t *BlDtAddDataAndAlign(uint32_t *cursor, const void *data, size_t size) {
+    size_t words = BL_ALIGN_UP(size, 4) / 4;
 
-    BlCopyMemory(structure + curOff, data, size);
-    BlFillMemory(structure + curOff + size, 0, aligned - size);
+    // clear the padding before the data lands on top of it
+    if (words != 0) cursor[words - 1] = 0;
+    BlCopyMemory(cursor, data, size);
 
-    *offset = newOff;
+    return cursor + words;
 }
 
-static void BlDtAddToken(void *structure, size_t *offset, uint32_t token) {
-    size_t curOff = *offset;
-    size_t newOff = curOff + 4;
-    BL_ASSERT(newOff <= BlDtStructureSize);
+static uint32_t *BlDtAddToken(uint32_t *cursor, uint32_t token) {
+    *cursor = BL_BE32(token);
+    return cursor + 1;
+}
 
-    *(uint32_t *)(structure + curOff) = BL_BE32(token);
+static size_t BiBlobSize(void) {
+    size_t rsvMapSize = (BlDtRsvMemCount + 1) * sizeof(struct BlFdtRsvmapEntry);
+    return sizeof(struct BlFdtHeader) + rsvMapSize + BlDtStructureSize + BlDtStringsSize;
+}
+
+// describes the boot memory ranges, with room for `extra` more that may be reserved before the blob is built
+static struct BlDtProperty *BiAddBootMemoryNode(size_t extra) {
+    auto node = BlDtCreateNode(BlDtGetReservedMemoryNode(), "xrlinux-boot");
+    BlDtAddPropertyString(node, "compatible", "xrlinux,boot-memory");
 
-    *offset = newOff;
+    uint32_t cells = BiGetCellCount(node->Parent, "#address-cells", 2) + BiGetCellCount(node->Parent, "#size-cells", 1);
+    uint32_t size = (BiBootRangeCount + extra) * cells * sizeof(uint32_t);
+    return BlDtDoAddProperty(node, "reg", BI_ARENA_ALLOCATE(uint32_t, size / sizeof(uint32_t)), size);
+}
+
+static void BiFillBootMemoryNode(struct BlDtProperty *reg) {
+    auto reservedMemory = BlDtGetReservedMemoryNode();
+    uint32_t addressCells = BiGetCellCount(reservedMemory, "#address-cells", 2);
+    uint32_t sizeCells = BiGetCellCount(reservedMemory, "#size-cells", 1);
+    uint32_t size = BiBootRangeCount * (addressCells + sizeCells) * sizeof(uint32_t);
+    if (size > reg->Size) BlCrash("too many boot memory ranges");
+
+    uint32_t *cells = reg->Data;
+
+    for (size_t i = 0; i < BiBootRangeCount; i++) {
+        cells = BiEncodeCells(cells, BiBootRanges[i].Start, addressCells);
+        cells = BiEncodeCells(cells, BiBootRanges[i].End - BiBootRanges[i].Start, sizeCells);
+    }
+
+    BlDtStructureSize -= BL_DT_PROP_SIZE(reg->Size) - BL_DT_PROP_SIZE(size);
+    reg->Size = size;
 }
 
 void *BlDtBuildBlob(void) {
     BlPrint("Creating device tree blob\n");
 
-    size_t rsvMapSize = (BlDtRsvMemCount + 1) * sizeof(struct BlFdtRsvmapEntry);
-    size_t totalSize = sizeof(struct BlFdtHeader) + rsvMapSize + BlDtStructureSize + BlDtStringsSize;
     size_t alignment = _Alignof(struct BlFdtHeader);
 
     if (BlKernelHeader.Flags & BL_FLAG_MAP_DTB) {
         alignment = BL_MAX(alignment, BL_PAGE_SIZE);
 
-        if (BlKernelHeader.DtbAddress + (totalSize - 1) > BlKernelHeader.MaxDtbEnd) {
-            BlCrash("device tree too large to map");
-        }
+        // Creating page tables reserves memory too, so get that out of the way before sizing the ranges. The spare
+        // page covers the node that describes them.
+        size_t maxSize = BlKernelHeader.MaxDtbEnd - BlKernelHeader.DtbAddress + 1;
+        BlCreatePageTables(BlKernelHeader.DtbAddress, BL_MIN(BiBlobSize() + BL_PAGE_SIZE, maxSize));
+    }
+
+    // the blob reserves itself once it's allocated, which can add one more range
+    auto bootMemory = BiAddBootMemoryNode(1);
+    size_t totalSize = BiBlobSize();
+
+    if ((BlKernelHeader.Flags & BL_FLAG_MAP_DTB) &&
+        BlKernelHeader.DtbAddress + (totalSize - 1) > BlKernelHeader.MaxDtbEnd) {
+        BlCrash("device tree too large to map");
     }
 
     struct BlFdtHeader *header = BlAllocateHeap(totalSize, alignment, true);
 
+    // mapping the blob reserves whole pages, so do the same here to keep that from adding a range later
+    BlDtReserveBootMemory((uintptr_t)header, BL_ALIGN_UP(totalSize, alignment));
+
+    // the blob can only shrink from here on
+    BiFillBootMemoryNode(bootMemory);
+    totalSize = BiBlobSize();
+    size_t rsvMapSize = (BlDtRsvMemCount + 1) * sizeof(struct BlFdtRsvmapEntry);
+
     if (BlKernelHeader.Flags & BL_FLAG_MAP_DTB) {
         paddr_t phys = (paddr_t)(uintptr_t)header;
 
@@ -325,38 +530,24 @@ void *BlDtBuildBlob(void) {
     rsvmap[i].Address = 0;
     rsvmap[i].Size = 0;
 
-    // Build strings (this has to be done before structure to ensure BlDtString.Identifier is correct)
-    size_t offset = 0;
-    for (i = 0; i < BlDtStringsCapacity; i++) {
-        BL_LIST_FOREACH(BlDtStrings[i], struct BlDtString, Node, str) {
-            size_t size = BlStringLength(str->Data) + 1;
-            size_t newOffset = offset + size;
-            BL_ASSERT(newOffset <= BlDtStringsSize);
-
-            str->Identifier = offset;
-            BlCopyMemory(strings + offset, str->Data, size);
-
-            offset = newOffset;
-        }
-    }
-    BL_ASSERT(offset == BlDtStringsSize);
+    BlCopyMemory(strings, BlDtStrings, BlDtStringsSize);
 
     // Build structure
     struct BlDtNode *node = &BlDtRootNode;
     struct BlDtNode *previous = nullptr;
-    offset = 0;
+    uint32_t *cursor = structure;
 
     while (node) {
         if (previous == node->Parent) {
-            BlDtAddToken(structure, &offset, BL_FDT_BEGIN_NODE);
-            BlDtAddDataAndAlign(structure, &offset, node->Name, BlStringLength(node->Name) + 1);
-
-            for (i = 0; i < node->NumberOfProperties; i++) {
-                struct BlDtProperty *property = &node->Properties[i];
-                BlDtAddToken(structure, &offset, BL_FDT_PROP);
-                BlDtAddToken(structure, &offset, property->Size);
-                BlDtAddToken(structure, &offset, property->Name->Identifier);
-                BlDtAddDataAndAlign(structure, &offset, property->Data, property->Size);
+            cursor = BlDtAddToken(cursor, BL_FDT_BEGIN_NODE);
+            cursor = BlDtAddDataAndAlign(cursor, node->Name, BlStringLength(node->Name) + 1);
+
+            for (auto property = node->Properties; property != nullptr; property = property->Next) {
+                cursor = BlDtAddToken(cursor, BL_FDT_PROP);
+                cursor = BlDtAddToken(cursor, property->Size);
+                cursor = BlDtAddToken(cursor, property->NameOffset);
+                property->BlobData = cursor;
+                cursor = BlDtAddDataAndAlign(cursor, property->Data, property->Size);
             }
 
             previous = BL_LIST_HEAD(struct BlDtNode, Node, node->Children);
@@ -369,14 +560,14 @@ void *BlDtBuildBlob(void) {
             previous = node;
             node = next;
         } else {
-            BlDtAddToken(structure, &offset, BL_FDT_END_NODE);
+            cursor = BlDtAddToken(cursor, BL_FDT_END_NODE);
             previous = node;
             node = node->Parent;
         }
     }
 
-    BlDtAddToken(structure, &offset, BL_FDT_END);
-    BL_ASSERT(offset == BlDtStructureSize);
+    cursor = BlDtAddToken(cursor, BL_FDT_END);
+    BL_ASSERT((size_t)((void *)cursor - structure) == BlDtStructureSize);
 
     return header;
 }
@@ -7,14 +7,27 @@ struct BlDtNode;
 
 void BlDtAddReservedMemory(uint64_t base, uint64_t size);
 
+// Records memory that the kernel must not reuse (its image, page tables, the blob and the initrd). It is described as
+// sorted, coalesced ranges under /reserved-memory.
+void BlDtReserveBootMemory(uint64_t base, uint64_t size);
+
 struct BlDtNode *BlDtCreateNode(struct BlDtNode *parent, const char *name);
 void BlDtAddProperty(struct BlDtNode *parent, const char *name, const void *data, uint32_t size);
 void BlDtAddPropertyU32s(struct BlDtNode *parent, const char *name, const uint32_t *data, uint32_t count);
 void BlDtAddPropertyStrings(struct BlDtNode *parent, const char *name, const char **data, size_t count);
+
+// adds `count` address and size pairs as the node's `reg`, encoded with the cell counts of its parent
+void BlDtAddPropertyReg(struct BlDtNode *node, const uint64_t *data, size_t count);
 uint32_t BlDtAllocPhandle(void);
 
 struct BlDtNode *BlDtFindNode(struct BlDtNode *parent, const char *name);
 
+// returns /reserved-memory, creating it with the same cell counts as the root node if it doesn't exist yet
+struct BlDtNode *BlDtGetReservedMemoryNode(void);
+
+// returns the location of the property's data in the most recently built blob
+void *BlDtGetBlobProperty(struct BlDtNode *node, const char *name);
+
 const char *BlDtNodeName(struct BlDtNode *node);
 char *BlDtNodePath(struct BlDtNode *node);
 
@@ -1,4 +1,5 @@
 #include "filesystem.h"
+#include "checksum.h"
 #include "compiler.h"
 #include "logging.h"
 #include "memory.h"
@@ -9,11 +10,19 @@
 #define BI_SIGNATURE 0xef53
 #define BI_ROOT_INODE 2
 
+#define BI_DIR_INDEX (1u << 5)
+
 #define BI_DIR_TYPES (1u << 1)
-#define BI_RO_FEATURES BI_DIR_TYPES
+#define BI_EXTENTS (1u << 6)
+#define BI_64BIT (1u << 7)
+#define BI_FLEX_BG (1u << 9)
+#define BI_RO_FEATURES (BI_DIR_TYPES | BI_EXTENTS | BI_64BIT | BI_FLEX_BG)
 
 #define BI_SIZE_64 (1u << 1)
 
+#define BI_SIGNED_HASH (1u << 0)
+#define BI_UNSIGNED_HASH (1u << 1)
+
 #define BI_TYPE(mode) ((mode) & 0xf000)
 #define BI_TYPE_DIR 0x4000
 #define BI_TYPE_REG 0x8000
@@ -24,8 +33,36 @@
 
 #define BI_INDIRECT_LEVELS 3
 
+#define BI_INODE_INDEX (1u << 12)
+#define BI_INODE_EXTENTS (1u << 19)
+
+#define BI_EXTENT_MAGIC 0xf30a
+#define BI_EXTENT_MAX_DEPTH 5
+#define BI_EXTENT_INIT_MAX 0x8000
+
+#define BI_GROUP_DESC_SIZE 32
+
+#define BI_HASH_LEGACY 0
+#define BI_HASH_HALF_MD4 1
+#define BI_HASH_TEA 2
+#define BI_HASH_LEGACY_UNSIGNED 3
+#define BI_HASH_HALF_MD4_UNSIGNED 4
+#define BI_HASH_TEA_UNSIGNED 5
+#define BI_HASH_EOF 0x7fffffffu
+
+#define BI_INDEX_MAX_LEVELS 3
+#define BI_INDEX_BLOCK_MASK 0x0fffffff
+
+#define BI_PATH_CACHE_NAME "xrlinux.cache"
+#define BI_PATH_CACHE_MAGIC 0x43505258
+#define BI_PATH_CACHE_VERSION 2
+#define BI_PATH_CACHE_GENERATION (1u << 0)
+#define BI_PATH_CACHE_MAX_SIZE 0x1'0000
+
+#define BI_CHECKSUM_BUFFER_SIZE 0x1000u
+
 struct BiSuperblock {
-    uint32_t _Inodes;
+    uint32_t Inodes;
     uint32_t _Blocks;
     uint32_t _RootBlocks;
     uint32_t _UnallocatedBlocks;
@@ -68,8 +105,24 @@ struct BiSuperblock {
     uint32_t _JournalInode;
     uint32_t _JournalDevice;
     uint32_t _OrphanedInodesHead;
+    uint32_t HashSeed[4];
+    uint8_t DefaultHashVersion;
+    uint8_t _JournalBackupType;
+    uint16_t GroupDescriptorSize;
+    uint32_t _DefaultMountOptions;
+    uint32_t _FirstMetaBlockGroup;
+    uint32_t _CreationTime;
+    uint32_t _JournalBlocks[17];
+    uint32_t _BlocksUpper;
+    uint32_t _RootBlocksUpper;
+    uint32_t _UnallocatedBlocksUpper;
+    uint16_t _MinExtraInodeSize;
+    uint16_t _WantExtraInodeSize;
+    uint32_t Flags;
 } __attribute__((packed, aligned(4)));
 
+_Static_assert(offsetof(struct BiSuperblock, Flags) == 0x160, "Superblock layout incorrect");
+
 struct BiBlockGroupDescriptor {
     uint32_t _BlockBitmap;
     uint32_t _InodeBitmap;
@@ -77,6 +130,16 @@ struct BiBlockGroupDescriptor {
     uint16_t _UnallocatedBlocks;
     uint16_t _UnallocatedInodes;
     uint16_t _Directories;
+    // following fields only valid with BI_64BIT
+    uint16_t _Flags;
+    uint32_t _ExcludeBitmap;
+    uint16_t _BlockBitmapChecksum;
+    uint16_t _InodeBitmapChecksum;
+    uint16_t _UnusedInodes;
+    uint16_t _Checksum;
+    uint32_t _BlockBitmapUpper;
+    uint32_t _InodeBitmapUpper;
+    uint32_t InodeTableBlockUpper;
 } __attribute__((packed, aligned(4)));
 
 struct BiInode {
@@ -84,25 +147,60 @@ struct BiInode {
     uint16_t _Uid;
     uint32_t Size;
     uint32_t _Atime;
-    uint32_t _Ctime;
-    uint32_t _Mtime;
+    uint32_t Ctime;
+    uint32_t Mtime;
     uint32_t _Dtime;
     uint16_t _Gid;
     uint16_t _Links;
     uint32_t _Sectors;
-    uint32_t _Flags;
+    uint32_t Flags;
     uint32_t _Osv1;
-    uint32_t DirectBlocks[12];
-    uint32_t IndirectBlocks[BI_INDIRECT_LEVELS];
-    /*uint32_t DoubleIndirectBlock;
-    uint32_t TripleIndirectBlock;*/
-    uint32_t _Generation;
+    union {
+        struct {
+            uint32_t DirectBlocks[12];
+            uint32_t IndirectBlocks[BI_INDIRECT_LEVELS];
+            /*uint32_t DoubleIndirectBlock;
+            uint32_t TripleIndirectBlock;*/
+        };
+        uint32_t ExtentTree[12 + BI_INDIRECT_LEVELS];
+    };
+    uint32_t Generation;
     uint32_t _ExtendedAttributesBlock;
     uint32_t SizeUpper;
     uint32_t _FragmentBlock;
     uint8_t Osv2[12];
 } __attribute__((packed, aligned(4)));
 
+// follows struct BiInode if the inode size is larger than 128, fields past ExtraSize bytes aren't stored
+struct BiInodeExtra {
+    uint16_t ExtraSize;
+    uint16_t _ChecksumUpper;
+    uint32_t CtimeExtra;
+    uint32_t MtimeExtra;
+} __attribute__((packed, aligned(4)));
+
+struct BiExtentHeader {
+    uint16_t Magic;
+    uint16_t Entries;
+    uint16_t _Max;
+    uint16_t Depth;
+    uint32_t _Generation;
+} __attribute__((packed, aligned(4)));
+
+struct BiExtentIndex {
+    uint32_t Block;
+    uint32_t Leaf;
+    uint16_t LeafUpper;
+    uint16_t _Unused;
+} __attribute__((packed, aligned(4)));
+
+struct BiExtentLeaf {
+    uint32_t Block;
+    uint16_t Length;
+    uint16_t StartUpper;
+    uint32_t Start;
+} __attribute__((packed, aligned(4)));
+
 struct BiEntry {
     uint32_t Inode;
     uint16_t Size;
@@ -110,25 +208,117 @@ struct BiEntry {
     uint8_t Type;
 } __attribute__((packed, aligned(4)));
 
+// a run of logical blocks that are either all sparse (Start == 0) or stored in physically adjacent blocks
+struct BiExtent {
+    uint64_t Block;
+    uint64_t Count;
+    uint64_t Start;
+};
+
+struct BiIndexRoot {
+    uint32_t _DotInode;
+    uint16_t _DotSize;
+    uint8_t _DotNameLength;
+    uint8_t _DotType;
+    char _DotName[4];
+    uint32_t _DotDotInode;
+    uint16_t _DotDotSize;
+    uint8_t _DotDotNameLength;
+    uint8_t _DotDotType;
+    char _DotDotName[4];
+    uint32_t _Reserved;
+    uint8_t HashVersion;
+    uint8_t InfoLength;
+    uint8_t IndirectLevels;
+    uint8_t _Flags;
+} __attribute__((packed, aligned(4)));
+
+// the first entry of an index node stores the limit and count in place of the hash
+struct BiIndexEntry {
+    union {
+        uint32_t Hash;
+        struct {
+            uint16_t Limit;
+            uint16_t Count;
+        };
+    };
+    uint32_t Block;
+} __attribute__((packed, aligned(4)));
+
+// The path cache is written by mkpathcache. For every path, it lists the inodes that looking the path up depends on
+// (each directory searched, each symlink followed, and lastly the file itself) followed by the file's extents. As long
+// as none of those inodes changed, the path still leads to the same file stored in the same blocks.
+struct BiPathCacheHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EntryCount;
+    uint32_t _Reserved;
+} __attribute__((packed, aligned(4)));
+
+// followed by the path (padded to a multiple of 4 bytes), the inodes, and the extents
+struct BiPathCacheEntry {
+    uint32_t PathLength;
+    uint32_t InodeCount;
+    uint32_t ExtentCount;
+    uint32_t _Reserved;
+} __attribute__((packed, aligned(4)));
+
+struct BiPathCacheInode {
+    uint32_t Inode;
+    uint32_t Flags;
+    uint32_t Generation;
+    uint32_t _Reserved;
+    uint32_t Mtime;
+    uint32_t MtimeNsec;
+    uint32_t Ctime;
+    uint32_t CtimeNsec;
+    uint64_t Size;
+} __attribute__((packed, aligned(4)));
+
+struct BiPathCacheExtent {
+    uint64_t Block;
+    uint64_t Count;
+    uint64_t Start;
+} __attribute__((packed, aligned(4)));
+
 struct BlFsFile {
     struct BiInode Inode;
+    struct BiExtent *Extents;
+    size_t NumberOfExtents;
+    size_t ExtentsCapacity;
+    size_t CurrentExtent;
+    bool Mapped;
+    bool Checksumming;
+    uint32_t Checksum;
+    uint64_t ChecksumPosition;
 };
 
 static struct BiSuperblock BiSuperblock;
 static size_t BiBlockSize;
 static uint64_t BiBgdtLocation;
+static size_t BiGroupDescriptorSize;
+static uint32_t BiGroupDescriptorShift;
 static uint32_t BiInodeShift;
 static uint32_t BiIndirectionShift;
 static uint32_t BiIndirectionCount;
-static uint32_t BiIndirectionMask;
-static struct BiInode BiRoot;
+static struct BlFsFile BiRoot;
+static void *BiPathCache;
+static size_t BiPathCacheSize;
 
 static void BiReadBlockGroupDescriptor(struct BiBlockGroupDescriptor *out, uint32_t group) {
-    BlReadFromPartition(out, BiBgdtLocation + (uint64_t)group * 32, sizeof(*out), false);
+    size_t size = BL_MIN(BiGroupDescriptorSize, sizeof(*out));
+
+    BlReadFromPartition(out, BiBgdtLocation + ((uint64_t)group << BiGroupDescriptorShift), size, false);
     out->InodeTableBlock = BL_LE32(out->InodeTableBlock);
+
+    if (BiSuperblock.RequiredFeatures & BI_64BIT) {
+        out->InodeTableBlockUpper = BL_LE32(out->InodeTableBlockUpper);
+    } else {
+        out->InodeTableBlockUpper = 0;
+    }
 }
 
-static void BiReadInode(struct BiInode *out, uint32_t inode) {
+static uint64_t BiInodeLocation(uint32_t inode) {
     uint32_t group = (inode - 1) / BiSuperblock.BlockGroupInodes;
     uint32_t index = (inode - 1) % BiSuperblock.BlockGroupInodes;
     uint64_t offset = (uint64_t)index << BiInodeShift;
@@ -136,120 +326,570 @@ static void BiReadInode(struct BiInode *out, uint32_t inode) {
     struct BiBlockGroupDescriptor groupDescriptor;
     BiReadBlockGroupDescriptor(&groupDescriptor, group);
 
-    uint64_t location = ((uint64_t)groupDescriptor.InodeTableBlock << BiSuperblock.BlockSizeShift) + offset;
-    BlReadFromPartition(out, location, sizeof(*out), false);
+    uint64_t table = ((uint64_t)groupDescriptor.InodeTableBlockUpper << 32) | groupDescriptor.InodeTableBlock;
+    return (table << BiSuperblock.BlockSizeShift) + offset;
+}
+
+static void BiReadInode(struct BlFsFile *out, uint32_t inode) {
+    BlReadFromPartition(&out->Inode, BiInodeLocation(inode), sizeof(out->Inode), false);
+
+    out->Inode.Mode = BL_LE16(out->Inode.Mode);
+    out->Inode.Size = BL_LE32(out->Inode.Size);
+    out->Inode.Flags = BL_LE32(out->Inode.Flags);
+    out->Inode.Ctime = BL_LE32(out->Inode.Ctime);
+    out->Inode.Mtime = BL_LE32(out->Inode.Mtime);
+    out->Inode.Generation = BL_LE32(out->Inode.Generation);
+
+    // the extent tree is decoded when the file is mapped
+    if ((out->Inode.Flags & BI_INODE_EXTENTS) == 0) {
+        for (size_t i = 0; i < BL_ARRAY_SIZE(out->Inode.DirectBlocks); i++) {
+            out->Inode.DirectBlocks[i] = BL_LE32(out->Inode.DirectBlocks[i]);
+        }
 
-    for (size_t i = 0; i < BL_ARRAY_SIZE(out->DirectBlocks); i++) {
-        out->DirectBlocks[i] = BL_LE32(out->DirectBlocks[i]);
+        for (size_t i = 0; i < BI_INDIRECT_LEVELS; i++) {
+            out->Inode.IndirectBlocks[i] = BL_LE32(out->Inode.IndirectBlocks[i]);
+        }
     }
 
-    for (size_t i = 0; i < BI_INDIRECT_LEVELS; i++) {
-        out->IndirectBlocks[i] = BL_LE32(out->IndirectBlocks[i]);
+    if (BiSuperblock.WriteRequiredFeatures & BI_SIZE_64) out->Inode.SizeUpper = BL_LE32(out->Inode.SizeUpper);
+
+    out->Extents = nullptr;
+    out->NumberOfExtents = 0;
+    out->ExtentsCapacity = 0;
+    out->CurrentExtent = 0;
+    out->Mapped = false;
+    out->Checksumming = false;
+}
+
+static uint64_t BiInodeSize(struct BiInode *inode) {
+    uint64_t size = inode->Size;
+
+    if ((BiSuperblock.WriteRequiredFeatures & BI_SIZE_64) != 0 && BI_TYPE(inode->Mode) != BI_TYPE_DIR) {
+        size |= (uint64_t)inode->SizeUpper << 32;
     }
 
-    out->Mode = BL_LE16(out->Mode);
-    out->Size = BL_LE32(out->Size);
+    return size;
+}
+
+static void BiAddExtent(struct BlFsFile *file, uint64_t block, uint64_t count, uint64_t start) {
+    if (file->NumberOfExtents != 0) {
+        struct BiExtent *last = &file->Extents[file->NumberOfExtents - 1];
 
-    if (BiSuperblock.WriteRequiredFeatures & BI_SIZE_64) out->SizeUpper = BL_LE32(out->SizeUpper);
+        if (last->Block + last->Count == block && (last->Start ? last->Start + last->Count : 0) == start) {
+            last->Count += count;
+            return;
+        }
+    }
+
+    if (file->NumberOfExtents == file->ExtentsCapacity) {
+        file->ExtentsCapacity = file->ExtentsCapacity ? file->ExtentsCapacity * 2 : 8;
+        file->Extents = BL_RESIZE(struct BiExtent, file->Extents, file->ExtentsCapacity);
+    }
+
+    struct BiExtent *extent = &file->Extents[file->NumberOfExtents++];
+    extent->Block = block;
+    extent->Count = count;
+    extent->Start = start;
 }
 
-static uint32_t BiReadFromPointerBlock(uint32_t block, uint32_t index) {
-    uint32_t value;
-    BlReadFromPartition(&value, (block << BiSuperblock.BlockSizeShift) + index * sizeof(value), sizeof(value), false);
-    return BL_LE32(value);
+static void BiMapIndirectBlock(struct BlFsFile *file, uint32_t block, size_t level, uint64_t *current, uint64_t end) {
+    if (!block) {
+        uint64_t count = BL_MIN((uint64_t)BiIndirectionCount << (BiIndirectionShift * level), end - *current);
+        BiAddExtent(file, *current, count, 0);
+        *current += count;
+        return;
+    }
+
+    // pointer blocks are only ever read once per file, so don't let them evict anything from the block cache
+    uint32_t *pointers = BlAllocateHeap(BiBlockSize, BiBlockSize, false);
+    BlReadFromPartition(pointers, (uint64_t)block << BiSuperblock.BlockSizeShift, BiBlockSize, true);
+
+    for (size_t i = 0; i < BiIndirectionCount && *current < end; i++) {
+        uint32_t entry = BL_LE32(pointers[i]);
+
+        if (level == 0) {
+            BiAddExtent(file, *current, 1, entry);
+            *current += 1;
+        } else {
+            BiMapIndirectBlock(file, entry, level - 1, current, end);
+        }
+    }
+
+    BlFreeHeap(pointers);
 }
 
-static uint64_t BiGetInodeBlockBase(struct BiInode *inode, uint64_t block) {
-    if (block < BL_ARRAY_SIZE(inode->DirectBlocks)) return inode->DirectBlocks[block];
-    block -= BL_ARRAY_SIZE(inode->DirectBlocks);
+static void BiMapExtentNode(struct BlFsFile *file, const void *node, size_t size, uint16_t depth) {
+    const struct BiExtentHeader *header = node;
+    uint16_t entries = BL_LE16(header->Entries);
+
+    if (BL_LE16(header->Magic) != BI_EXTENT_MAGIC) BlCrash("invalid extent tree node");
+    if (BL_LE16(header->Depth) != depth) BlCrash("extent tree depth mismatch");
+    if (entries > (size - sizeof(*header)) / sizeof(struct BiExtentLeaf)) BlCrash("extent tree node too large");
 
-    uint32_t blocks = BiIndirectionCount;
-    size_t level;
+    if (depth == 0) {
+        const struct BiExtentLeaf *leaves = node + sizeof(*header);
 
-    for (level = 0; level < BI_INDIRECT_LEVELS; level++) {
-        if (block < blocks) break;
-        block -= blocks;
-        blocks <<= BiIndirectionShift;
+        for (size_t i = 0; i < entries; i++) {
+            uint32_t length = BL_LE16(leaves[i].Length);
+            uint64_t start = ((uint64_t)BL_LE16(leaves[i].StartUpper) << 32) | BL_LE32(leaves[i].Start);
+
+            // uninitialized extents read as zeroes
+            if (length > BI_EXTENT_INIT_MAX) {
+                length -= BI_EXTENT_INIT_MAX;
+                start = 0;
+            }
+
+            BiAddExtent(file, BL_LE32(leaves[i].Block), length, start);
+        }
+    } else {
+        const struct BiExtentIndex *indices = node + sizeof(*header);
+        void *buffer = BlAllocateHeap(BiBlockSize, BiBlockSize, false);
+
+        for (size_t i = 0; i < entries; i++) {
+            uint64_t leaf = ((uint64_t)BL_LE16(indices[i].LeafUpper) << 32) | BL_LE32(indices[i].Leaf);
+
+            BlReadFromPartition(buffer, leaf << BiSuperblock.BlockSizeShift, BiBlockSize, true);
+            BiMapExtentNode(file, buffer, BiBlockSize, depth - 1);
+        }
+
+        BlFreeHeap(buffer);
     }
+}
 
-    if (level >= BI_INDIRECT_LEVELS) BlCrash("tried to read beyond inode maximum bounds");
+static void BiMapFile(struct BlFsFile *file) {
+    if (file->Inode.Flags & BI_INODE_EXTENTS) {
+        const struct BiExtentHeader *header = (const void *)file->Inode.ExtentTree;
+        uint16_t depth = BL_LE16(header->Depth);
+        if (depth > BI_EXTENT_MAX_DEPTH) BlCrash("extent tree too deep");
 
-    uint32_t volumeBlock = inode->IndirectBlocks[level++];
+        BiMapExtentNode(file, file->Inode.ExtentTree, sizeof(file->Inode.ExtentTree), depth);
+        file->Mapped = true;
+        return;
+    }
 
-    while (level > 0) {
-        if (!volumeBlock) break;
+    uint64_t end = (BiInodeSize(&file->Inode) + (BiBlockSize - 1)) >> BiSuperblock.BlockSizeShift;
+    uint64_t current = 0;
 
-        uint32_t index = (block >> (BiIndirectionShift * --level)) & BiIndirectionMask;
-        volumeBlock = BiReadFromPointerBlock(volumeBlock, index);
+    for (size_t i = 0; i < BL_ARRAY_SIZE(file->Inode.DirectBlocks) && current < end; i++) {
+        BiAddExtent(file, current++, 1, file->Inode.DirectBlocks[i]);
     }
 
-    return volumeBlock;
+    for (size_t i = 0; i < BI_INDIRECT_LEVELS && current < end; i++) {
+        BiMapIndirectBlock(file, file->Inode.IndirectBlocks[i], i, &current, end);
+    }
+
+    if (current < end) BlCrash("inode size exceeds maximum bounds");
+
+    file->Mapped = true;
 }
 
-static void BiReadFromInode(struct BiInode *inode, void *buffer, size_t size, uint64_t position, bool bypassCache) {
-    while (size) {
-        uint64_t block = position >> BiSuperblock.BlockSizeShift;
-        size_t offset = position & (BiBlockSize - 1);
-        size_t current = BL_MIN(size, BiBlockSize - offset);
+static struct BiExtent *BiFindExtent(struct BlFsFile *file, uint64_t block) {
+    if (!file->Mapped) BiMapFile(file);
+    if (file->NumberOfExtents == 0) return nullptr;
+
+    // sequential reads almost always hit either the current extent or the one after it
+    for (size_t i = file->CurrentExtent; i < file->NumberOfExtents && i <= file->CurrentExtent + 1; i++) {
+        struct BiExtent *extent = &file->Extents[i];
+
+        if (block >= extent->Block && block - extent->Block < extent->Count) {
+            file->CurrentExtent = i;
+            return extent;
+        }
+    }
+
+    size_t min = 0;
+    size_t max = file->NumberOfExtents;
+
+    while (min < max) {
+        size_t mid = min + (max - min) / 2;
+        struct BiExtent *extent = &file->Extents[mid];
+
+        if (block < extent->Block) {
+            max = mid;
+        } else if (block - extent->Block >= extent->Count) {
+            min = mid + 1;
+        } else {
+            file->CurrentExtent = mid;
+            return extent;
+        }
+    }
+
+    return nullptr;
+}
+
+// returns the number of bytes (at most count) starting at position that are either all sparse or stored in physically
+// adjacent blocks, and sets *base to the partition offset of position (or 0 if it is sparse)
+static size_t BiGetInodeRun(struct BlFsFile *file, uint64_t position, size_t count, uint64_t *base) {
+    uint64_t block = position >> BiSuperblock.BlockSizeShift;
+    size_t offset = position & (BiBlockSize - 1);
+
+    struct BiExtent *extent = BiFindExtent(file, block);
+
+    if (!extent) {
+        *base = 0;
+        return BL_MIN(BiBlockSize - offset, count);
+    }
+
+    uint64_t index = block - extent->Block;
+    uint64_t length = ((extent->Count - index) << BiSuperblock.BlockSizeShift) - offset;
+
+    *base = extent->Start ? ((extent->Start + index) << BiSuperblock.BlockSizeShift) + offset : 0;
+    return BL_MIN(length, count);
+}
+
+// Only data that continues right where the checksum left off is added to it. Reads that skip ahead (such as a
+// decompressor looking at the trailer first) are left out, the data they cover is picked up once it's read in order.
+static void BiUpdateChecksum(struct BlFsFile *file, const unsigned char *buffer, size_t size, uint64_t position) {
+    if (position > file->ChecksumPosition || position + size <= file->ChecksumPosition) return;
 
-        uint64_t blockBase = BiGetInodeBlockBase(inode, block) << BiSuperblock.BlockSizeShift;
+    size_t skip = file->ChecksumPosition - position;
+    file->Checksum = BlCrc32c(file->Checksum, buffer + skip, size - skip);
+    file->ChecksumPosition = position + size;
+}
+
+static void BiReadFromInode(struct BlFsFile *file, void *buffer, size_t size, uint64_t position, bool bypassCache) {
+    while (size) {
+        uint64_t base;
+        size_t current = BiGetInodeRun(file, position, size, &base);
 
-        if (blockBase) {
-            BlReadFromPartition(buffer, blockBase + offset, current, bypassCache);
+        if (base) {
+            BlReadFromPartition(buffer, base, current, bypassCache);
         } else {
             BlFillMemory(buffer, 0, current);
         }
 
+        // checksum each run while it's still in the cache
+        if (file->Checksumming) BiUpdateChecksum(file, buffer, current, position);
+
         buffer += current;
         size -= current;
         position += current;
     }
 }
 
-static uint64_t BiInodeSize(struct BiInode *inode) {
-    uint64_t size = inode->Size;
+static uint32_t BiRotateLeft(uint32_t value, unsigned count) {
+    return (value << count) | (value >> (32 - count));
+}
 
-    if ((BiSuperblock.WriteRequiredFeatures & BI_SIZE_64) != 0 && BI_TYPE(inode->Mode) != BI_TYPE_DIR) {
-        size |= (uint64_t)inode->SizeUpper << 32;
+static uint32_t BiHashLegacy(const unsigned char *name, size_t length, bool isSigned) {
+    uint32_t hash0 = 0x12a3fe2d;
+    uint32_t hash1 = 0x37abe8f9;
+
+    while (length--) {
+        int c = isSigned ? (signed char)*name++ : *name++;
+        uint32_t hash = hash1 + (hash0 ^ (uint32_t)(c * 7152373));
+
+        if (hash & 0x80000000) hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
     }
 
-    return size;
+    return hash0 << 1;
 }
 
-static bool BiFindEntryInDirectory(struct BiEntry *out, struct BiInode *dir, const void *name, size_t nameLength) {
-    if (nameLength > BI_MAX_NAME_LEN) return false;
+static void BiHashPrepare(uint32_t *out, size_t count, const unsigned char *name, size_t length, bool isSigned) {
+    uint32_t pad = (uint32_t)length | ((uint32_t)length << 8);
+    pad |= pad << 16;
+
+    uint32_t value = pad;
+    if (length > count * 4) length = count * 4;
+
+    for (size_t i = 0; i < length; i++) {
+        int c = isSigned ? (signed char)name[i] : name[i];
+        value = (uint32_t)c + (value << 8);
+
+        if ((i % 4) == 3) {
+            *out++ = value;
+            value = pad;
+            count--;
+        }
+    }
+
+    if (count > 0) {
+        *out++ = value;
+        count--;
+    }
+
+    while (count > 0) {
+        *out++ = pad;
+        count--;
+    }
+}
+
+#define BI_MD4_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define BI_MD4_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define BI_MD4_H(x, y, z) ((x) ^ (y) ^ (z))
+#define BI_MD4_ROUND(f, a, b, c, d, x, s) ((a) = BiRotateLeft((a) + f((b), (c), (d)) + (x), (s)))
+
+#define BI_MD4_K2 013240474631u
+#define BI_MD4_K3 015666365641u
+
+static void BiHalfMd4Transform(uint32_t buf[4], const uint32_t in[8]) {
+    uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+    BI_MD4_ROUND(BI_MD4_F, a, b, c, d, in[0], 3);
+    BI_MD4_ROUND(BI_MD4_F, d, a, b, c, in[1], 7);
+    BI_MD4_ROUND(BI_MD4_F, c, d, a, b, in[2], 11);
+    BI_MD4_ROUND(BI_MD4_F, b, c, d, a, in[3], 19);
+    BI_MD4_ROUND(BI_MD4_F, a, b, c, d, in[4], 3);
+    BI_MD4_ROUND(BI_MD4_F, d, a, b, c, in[5], 7);
+    BI_MD4_ROUND(BI_MD4_F, c, d, a, b, in[6], 11);
+    BI_MD4_ROUND(BI_MD4_F, b, c, d, a, in[7], 19);
+
+    BI_MD4_ROUND(BI_MD4_G, a, b, c, d, in[1] + BI_MD4_K2, 3);
+    BI_MD4_ROUND(BI_MD4_G, d, a, b, c, in[3] + BI_MD4_K2, 5);
+    BI_MD4_ROUND(BI_MD4_G, c, d, a, b, in[5] + BI_MD4_K2, 9);
+    BI_MD4_ROUND(BI_MD4_G, b, c, d, a, in[7] + BI_MD4_K2, 13);
+    BI_MD4_ROUND(BI_MD4_G, a, b, c, d, in[0] + BI_MD4_K2, 3);
+    BI_MD4_ROUND(BI_MD4_G, d, a, b, c, in[2] + BI_MD4_K2, 5);
+    BI_MD4_ROUND(BI_MD4_G, c, d, a, b, in[4] + BI_MD4_K2, 9);
+    BI_MD4_ROUND(BI_MD4_G, b, c, d, a, in[6] + BI_MD4_K2, 13);
+
+    BI_MD4_ROUND(BI_MD4_H, a, b, c, d, in[3] + BI_MD4_K3, 3);
+    BI_MD4_ROUND(BI_MD4_H, d, a, b, c, in[7] + BI_MD4_K3, 9);
+    BI_MD4_ROUND(BI_MD4_H, c, d, a, b, in[2] + BI_MD4_K3, 11);
+    BI_MD4_ROUND(BI_MD4_H, b, c, d, a, in[6] + BI_MD4_K3, 15);
+    BI_MD4_ROUND(BI_MD4_H, a, b, c, d, in[1] + BI_MD4_K3, 3);
+    BI_MD4_ROUND(BI_MD4_H, d, a, b, c, in[5] + BI_MD4_K3, 9);
+    BI_MD4_ROUND(BI_MD4_H, c, d, a, b, in[0] + BI_MD4_K3, 11);
+    BI_MD4_ROUND(BI_MD4_H, b, c, d, a, in[4] + BI_MD4_K3, 15);
+
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+static void BiTeaTransform(uint32_t buf[4], const uint32_t in[4]) {
+    uint32_t sum = 0;
+    uint32_t b0 = buf[0], b1 = buf[1];
+
+    for (size_t i = 0; i < 16; i++) {
+        sum += 0x9e3779b9;
+        b0 += ((b1 << 4) + in[0]) ^ (b1 + sum) ^ ((b1 >> 5) + in[1]);
+        b1 += ((b0 << 4) + in[2]) ^ (b0 + sum) ^ ((b0 >> 5) + in[3]);
+    }
+
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
+// computes the htree hash of a name, matching ext4fs_dirhash in linux
+static bool BiHashName(uint32_t *out, const unsigned char *name, size_t length, unsigned version) {
+    uint32_t buf[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    uint32_t in[8];
+    uint32_t hash;
+
+    for (size_t i = 0; i < BL_ARRAY_SIZE(buf); i++) {
+        if (BiSuperblock.HashSeed[i]) {
+            BlCopyMemory(buf, BiSuperblock.HashSeed, sizeof(buf));
+            break;
+        }
+    }
+
+    switch (version) {
+    case BI_HASH_LEGACY:
+    case BI_HASH_LEGACY_UNSIGNED: hash = BiHashLegacy(name, length, version == BI_HASH_LEGACY); break;
+    case BI_HASH_HALF_MD4:
+    case BI_HASH_HALF_MD4_UNSIGNED:
+        for (size_t i = 0; i < length; i += 32) {
+            BiHashPrepare(in, 8, name + i, length - i, version == BI_HASH_HALF_MD4);
+            BiHalfMd4Transform(buf, in);
+        }
 
-    uint64_t offset = 0;
-    auto buffer = BL_ALLOCATE(char, nameLength);
+        hash = buf[1];
+        break;
+    case BI_HASH_TEA:
+    case BI_HASH_TEA_UNSIGNED:
+        for (size_t i = 0; i < length; i += 16) {
+            BiHashPrepare(in, 4, name + i, length - i, version == BI_HASH_TEA);
+            BiTeaTransform(buf, in);
+        }
 
-    while (BiInodeSize(dir) - offset >= sizeof(*out)) {
-        BiReadFromInode(dir, out, sizeof(*out), offset, false);
+        hash = buf[0];
+        break;
+    default: return false;
+    }
 
-        out->Inode = BL_LE32(out->Inode);
-        out->Size = BL_LE16(out->Size);
+    hash &= ~1u;
+    if (hash == (BI_HASH_EOF << 1)) hash = (BI_HASH_EOF - 1) << 1;
 
-        if ((BiSuperblock.RequiredFeatures & BI_DIR_TYPES) != 0 || out->Type == 0) {
-            if (out->Inode != 0 && out->NameLength == nameLength) {
-                BiReadFromInode(dir, buffer, nameLength, offset + sizeof(*out), false);
+    *out = hash;
+    return true;
+}
 
-                if (BlCompareMemory(buffer, name, nameLength) == 0) {
-                    BlFreeHeap(buffer);
-                    return true;
-                }
+static bool BiFindEntryInBlock(struct BiEntry *out, const void *block, const void *name, size_t nameLength) {
+    size_t offset = 0;
+
+    while (BiBlockSize - offset >= sizeof(*out)) {
+        const struct BiEntry *entry = block + offset;
+        uint16_t size = BL_LE16(entry->Size);
+
+        if (size < sizeof(*entry) || size > BiBlockSize - offset) break;
+
+        if ((BiSuperblock.RequiredFeatures & BI_DIR_TYPES) != 0 || entry->Type == 0) {
+            if (entry->Inode != 0 && entry->NameLength == nameLength && sizeof(*entry) + nameLength <= size &&
+                BlCompareMemory(entry + 1, name, nameLength) == 0) {
+                out->Inode = BL_LE32(entry->Inode);
+                out->Size = size;
+                out->NameLength = entry->NameLength;
+                out->Type = entry->Type;
+                return true;
             }
         }
 
-        offset += out->Size;
+        offset += size;
     }
 
-    BlFreeHeap(buffer);
     return false;
 }
 
+static void BiReadDirectoryBlock(struct BlFsFile *dir, void *buffer, uint64_t block) {
+    BiReadFromInode(dir, buffer, BiBlockSize, block << BiSuperblock.BlockSizeShift, false);
+}
+
+// returns the entries of an index node and validates their count, or nullptr if the node is malformed
+static const struct BiIndexEntry *BiGetIndexEntries(const void *node, size_t offset, uint16_t *count) {
+    if (offset + sizeof(struct BiIndexEntry) > BiBlockSize) return nullptr;
+
+    const struct BiIndexEntry *entries = node + offset;
+    uint16_t limit = BL_LE16(entries->Limit);
+    *count = BL_LE16(entries->Count);
+
+    if (*count == 0 || *count > limit) return nullptr;
+    if (limit > (BiBlockSize - offset) / sizeof(*entries)) return nullptr;
+
+    return entries;
+}
+
+// looks a name up using the directory's htree index; returns false if the index can't be used
+static bool BiFindEntryInIndex(
+    struct BiEntry *out,
+    struct BlFsFile *dir,
+    void *node,
+    void *leaf,
+    const void *name,
+    size_t nameLength,
+    bool *found
+) {
+    BiReadDirectoryBlock(dir, node, 0);
+
+    const struct BiIndexRoot *root = node;
+    unsigned version = root->HashVersion;
+    size_t levels = root->IndirectLevels + 1;
+
+    if (levels > BI_INDEX_MAX_LEVELS) return false;
+
+    if (version <= BI_HASH_TEA && (BiSuperblock.Flags & BI_UNSIGNED_HASH) != 0) {
+        version += BI_HASH_LEGACY_UNSIGNED;
+    }
+
+    uint32_t hash;
+    if (!BiHashName(&hash, name, nameLength, version)) return false;
+
+    size_t rootOffset = offsetof(struct BiIndexRoot, _Reserved) + root->InfoLength;
+    size_t offset = rootOffset;
+    const struct BiIndexEntry *entries;
+    uint16_t count;
+
+    // the index node and the entry taken at every level, for moving on to the next leaf
+    uint32_t pathBlocks[BI_INDEX_MAX_LEVELS];
+    size_t pathIndices[BI_INDEX_MAX_LEVELS];
+    uint32_t block = 0;
+
+    for (size_t level = 0;; level++) {
+        entries = BiGetIndexEntries(node, offset, &count);
+        if (!entries) return false;
+
+        // find the last entry whose hash is less than or equal to the one we're looking for
+        size_t min = 1;
+        size_t max = count;
+
+        while (min < max) {
+            size_t mid = min + (max - min) / 2;
+
+            if (BL_LE32(entries[mid].Hash) > hash) {
+                max = mid;
+            } else {
+                min = mid + 1;
+            }
+        }
+
+        pathBlocks[level] = block;
+        pathIndices[level] = min - 1;
+        if (level + 1 == levels) break;
+
+        // interior nodes start with an empty directory entry spanning the whole block
+        block = BL_LE32(entries[min - 1].Block) & BI_INDEX_BLOCK_MASK;
+        BiReadDirectoryBlock(dir, node, block);
+        offset = sizeof(struct BiEntry);
+    }
+
+    while (true) {
+        BiReadDirectoryBlock(dir, leaf, BL_LE32(entries[pathIndices[levels - 1]].Block) & BI_INDEX_BLOCK_MASK);
+
+        if (BiFindEntryInBlock(out, leaf, name, nameLength)) {
+            *found = true;
+            return true;
+        }
+
+        // Find the next leaf the same way ext4_htree_next_block does. If it is the first one under another index
+        // node, the entry leading to that node carries its hash.
+        size_t level = levels - 1;
+
+        while (++pathIndices[level] == count) {
+            if (level == 0) {
+                *found = false;
+                return true;
+            }
+
+            level -= 1;
+            BiReadDirectoryBlock(dir, node, pathBlocks[level]);
+            entries = BiGetIndexEntries(node, level == 0 ? rootOffset : sizeof(struct BiEntry), &count);
+            if (!entries) return false;
+        }
+
+        // a set low bit in the next leaf's hash means that hash collisions spilled over into it
+        if (BL_LE32(entries[pathIndices[level]].Hash) != (hash | 1)) break;
+
+        while (++level < levels) {
+            pathBlocks[level] = BL_LE32(entries[pathIndices[level - 1]].Block) & BI_INDEX_BLOCK_MASK;
+            pathIndices[level] = 0;
+
+            BiReadDirectoryBlock(dir, node, pathBlocks[level]);
+            entries = BiGetIndexEntries(node, sizeof(struct BiEntry), &count);
+            if (!entries) return false;
+        }
+    }
+
+    *found = false;
+    return true;
+}
+
+static bool BiFindEntryInDirectory(struct BiEntry *out, struct BlFsFile *dir, const void *name, size_t nameLength) {
+    if (nameLength > BI_MAX_NAME_LEN) return false;
+
+    uint64_t blocks = BiInodeSize(&dir->Inode) >> BiSuperblock.BlockSizeShift;
+    auto buffer = BL_ALLOCATE(unsigned char, BiBlockSize * 2);
+    bool found = false;
+
+    if ((BiSuperblock.OptionalFeatures & BI_DIR_INDEX) == 0 || (dir->Inode.Flags & BI_INODE_INDEX) == 0 ||
+        !BiFindEntryInIndex(out, dir, buffer, buffer + BiBlockSize, name, nameLength, &found)) {
+        for (uint64_t i = 0; i < blocks && !found; i++) {
+            BiReadDirectoryBlock(dir, buffer, i);
+            found = BiFindEntryInBlock(out, buffer, name, nameLength);
+        }
+    }
+
+    BlFreeHeap(buffer);
+    return found;
+}
+
 bool BlFsInitialize(void) {
     BlReadFromPartition(&BiSuperblock, BI_SUPERBLOCK_OFFSET, sizeof(BiSuperblock), false);
     if (BL_LE16(BiSuperblock.Signature) != BI_SIGNATURE) return false;
 
+    BiSuperblock.Inodes = BL_LE32(BiSuperblock.Inodes);
     BiSuperblock.BlockSizeShift = BL_LE32(BiSuperblock.BlockSizeShift) + 10;
     BiSuperblock.BlockGroupBlocks = BL_LE32(BiSuperblock.BlockGroupBlocks);
     BiSuperblock.BlockGroupInodes = BL_LE32(BiSuperblock.BlockGroupInodes);
@@ -260,11 +900,18 @@ bool BlFsInitialize(void) {
         BiSuperblock.OptionalFeatures = 0;
         BiSuperblock.RequiredFeatures = 0;
         BiSuperblock.WriteRequiredFeatures = 0;
+        BiSuperblock.Flags = 0;
+        BlFillMemory(BiSuperblock.HashSeed, 0, sizeof(BiSuperblock.HashSeed));
     } else {
         BiSuperblock.InodeSize = BL_LE16(BiSuperblock.InodeSize);
         BiSuperblock.OptionalFeatures = BL_LE32(BiSuperblock.OptionalFeatures);
         BiSuperblock.RequiredFeatures = BL_LE32(BiSuperblock.RequiredFeatures);
         BiSuperblock.WriteRequiredFeatures = BL_LE32(BiSuperblock.WriteRequiredFeatures);
+        BiSuperblock.Flags = BL_LE32(BiSuperblock.Flags);
+
+        for (size_t i = 0; i < BL_ARRAY_SIZE(BiSuperblock.HashSeed); i++) {
+            BiSuperblock.HashSeed[i] = BL_LE32(BiSuperblock.HashSeed[i]);
+        }
     }
 
     uint32_t missingFeatures = BiSuperblock.RequiredFeatures & ~BI_RO_FEATURES;
@@ -281,29 +928,67 @@ bool BlFsInitialize(void) {
 
     BiBlockSize = 1u << BiSuperblock.BlockSizeShift;
     BiBgdtLocation = ((BI_SUPERBLOCK_OFFSET >> BiSuperblock.BlockSizeShift) + 1) << BiSuperblock.BlockSizeShift;
+    BiGroupDescriptorSize = BI_GROUP_DESC_SIZE;
+
+    if (BiSuperblock.RequiredFeatures & BI_64BIT) {
+        BiGroupDescriptorSize = BL_LE16(BiSuperblock.GroupDescriptorSize);
+
+        if (BiGroupDescriptorSize < BI_GROUP_DESC_SIZE || (BiGroupDescriptorSize & (BiGroupDescriptorSize - 1))) {
+            BlPrint("BlFsInitialize: invalid group descriptor size %zu\n", BiGroupDescriptorSize);
+            return false;
+        }
+    }
+
+    BiGroupDescriptorShift = BlCountTrailingZeroes(BiGroupDescriptorSize);
     BiInodeShift = BlCountTrailingZeroes(BiSuperblock.InodeSize);
     BiIndirectionShift = BiSuperblock.BlockSizeShift - 2;
     BiIndirectionCount = 1u << BiIndirectionShift;
-    BiIndirectionMask = BiIndirectionCount - 1;
 
+    BlFreeHeap(BiRoot.Extents);
     BiReadInode(&BiRoot, BI_ROOT_INODE);
+
+    BlFreeHeap(BiPathCache);
+    BiPathCache = nullptr;
+    BiPathCacheSize = 0;
+
     return true;
 }
 
-static void BiMaybeFreeInode(struct BiInode *inode) {
-    if (inode != &BiRoot) BlFreeHeap(inode);
+static void BiMaybeFreeFile(struct BlFsFile *file) {
+    if (file != &BiRoot) {
+        BlFreeHeap(file->Extents);
+        BlFreeHeap(file);
+    }
 }
 
-static struct BiInode *BiFindInode(struct BiInode *inode, const char *path, size_t length, uint32_t symlinks) {
+static void BiReadSymlink(struct BlFsFile *file, char *buffer, size_t size) {
+    // short targets are stored in place of the block pointers, which BiReadInode has byte swapped
+    if (size < sizeof(file->Inode.ExtentTree) && (file->Inode.Flags & BI_INODE_EXTENTS) == 0) {
+        uint32_t words[BL_ARRAY_SIZE(file->Inode.ExtentTree)];
+
+        for (size_t i = 0; i < BL_ARRAY_SIZE(words); i++) {
+            words[i] = BL_LE32(file->Inode.ExtentTree[i]);
+        }
+
+        BlCopyMemory(buffer, words, size);
+        return;
+    }
+
+    BiReadFromInode(file, buffer, size, 0, false);
+}
+
+// the caller keeps ownership of dir, every other file opened along the way is freed unless it is returned
+static struct BlFsFile *BiFindInode(struct BlFsFile *dir, const char *path, size_t length, uint32_t symlinks) {
     if (symlinks == BI_MAX_SYMLINKS) return nullptr;
     if (length == 0) return nullptr;
-    if (path[0] == '/') inode = &BiRoot;
+
+    struct BlFsFile *file = path[0] == '/' ? &BiRoot : dir;
 
     struct BiEntry entry;
 
     do {
-        if (BI_TYPE(inode->Mode) != BI_TYPE_DIR) {
-            BiMaybeFreeInode(inode);
+        if (BI_TYPE(file->Inode.Mode) != BI_TYPE_DIR) {
+            if (file != dir) BiMaybeFreeFile(file);
             return nullptr;
         }
 
@@ -317,45 +1002,202 @@ static struct BiInode *BiFindInode(struct BiInode *inode, const char *path, size
         size_t componentLength = 0;
         while (componentLength < length && path[componentLength] != '/') componentLength++;
 
-        if (!BiFindEntryInDirectory(&entry, inode, path, componentLength)) {
-            BiMaybeFreeInode(inode);
+        if (!BiFindEntryInDirectory(&entry, file, path, componentLength)) {
+            if (file != dir) BiMaybeFreeFile(file);
             return nullptr;
         }
 
-        auto newInode = BL_ALLOCATE(struct BiInode, 1);
-        BiReadInode(newInode, entry.Inode);
+        auto newFile = BL_ALLOCATE(struct BlFsFile, 1);
+        BiReadInode(newFile, entry.Inode);
 
-        if (BI_TYPE(newInode->Mode) == BI_TYPE_SYM) {
-            auto size = BiInodeSize(newInode);
+        if (BI_TYPE(newFile->Inode.Mode) == BI_TYPE_SYM) {
+            auto size = BiInodeSize(&newFile->Inode);
             auto linkPath = BL_ALLOCATE(char, size);
-            BiReadFromInode(newInode, linkPath, size, 0, false);
-            BiMaybeFreeInode(newInode);
-            newInode = BiFindInode(inode, linkPath, size, symlinks + 1);
+            BiReadSymlink(newFile, linkPath, size);
+            BiMaybeFreeFile(newFile);
+            newFile = BiFindInode(file, linkPath, size, symlinks + 1);
             BlFreeHeap(linkPath);
         }
 
-        BiMaybeFreeInode(inode);
-        inode = newInode;
+        if (file != dir) BiMaybeFreeFile(file);
+        file = newFile;
 
-        if (!inode) return nullptr;
+        if (!file) return nullptr;
 
         path += componentLength;
         length -= componentLength;
     } while (length > 0);
 
-    return inode;
+    return file;
+}
+
+// The nanoseconds of the timestamps, or 0 for inodes that are too small to store them (as Linux reports them).
+static void BiReadInodeNanoseconds(uint32_t inode, uint32_t *mtimeNsec, uint32_t *ctimeNsec) {
+    struct BiInodeExtra extra = {};
+
+    if (BiSuperblock.InodeSize >= sizeof(struct BiInode) + sizeof(extra)) {
+        BlReadFromPartition(&extra, BiInodeLocation(inode) + sizeof(struct BiInode), sizeof(extra), false);
+        extra.ExtraSize = BL_LE16(extra.ExtraSize);
+    }
+
+    *ctimeNsec = 0;
+    *mtimeNsec = 0;
+
+    // the low two bits of the extra fields extend the seconds, the rest are the nanoseconds
+    if (extra.ExtraSize >= offsetof(struct BiInodeExtra, CtimeExtra) + sizeof(extra.CtimeExtra)) {
+        *ctimeNsec = BL_LE32(extra.CtimeExtra) >> 2;
+    }
+
+    if (extra.ExtraSize >= offsetof(struct BiInodeExtra, MtimeExtra) + sizeof(extra.MtimeExtra)) {
+        *mtimeNsec = BL_LE32(extra.MtimeExtra) >> 2;
+    }
+}
+
+static struct BlFsFile *BiOpenCachedFile(
+    const char *path,
+    const struct BiPathCacheInode *inodes,
+    size_t inodeCount,
+    const struct BiPathCacheExtent *extents,
+    size_t extentCount
+) {
+    if (inodeCount == 0) return nullptr;
+
+    auto file = BL_ALLOCATE(struct BlFsFile, 1);
+    file->Extents = nullptr;
+
+    for (size_t i = 0; i < inodeCount; i++) {
+        uint32_t inode = BL_LE32(inodes[i].Inode);
+        if (inode == 0 || inode > BiSuperblock.Inodes) goto stale;
+
+        BiReadInode(file, inode);
+
+        if (file->Inode.Mtime != BL_LE32(inodes[i].Mtime) || file->Inode.Ctime != BL_LE32(inodes[i].Ctime) ||
+            BiInodeSize(&file->Inode) != BL_LE64(inodes[i].Size)) {
+            goto stale;
+        }
+
+        // catches a file rewritten within the same second, or deleted and recreated under the same inode number
+        if ((BL_LE32(inodes[i].Flags) & BI_PATH_CACHE_GENERATION) &&
+            file->Inode.Generation != BL_LE32(inodes[i].Generation)) {
+            goto stale;
+        }
+
+        uint32_t mtimeNsec, ctimeNsec;
+        BiReadInodeNanoseconds(inode, &mtimeNsec, &ctimeNsec);
+
+        if (mtimeNsec != BL_LE32(inodes[i].MtimeNsec) || ctimeNsec != BL_LE32(inodes[i].CtimeNsec)) goto stale;
+    }
+
+    if (BI_TYPE(file->Inode.Mode) != BI_TYPE_REG) goto stale;
+
+    // the extents are trusted from here on, so make sure they can't send reads outside the partition
+    uint64_t partitionBlocks = BlRootPartitionSize() >> BiSuperblock.BlockSizeShift;
+    uint64_t nextBlock = 0;
+
+    for (size_t i = 0; i < extentCount; i++) {
+        uint64_t block = BL_LE64(extents[i].Block);
+        uint64_t count = BL_LE64(extents[i].Count);
+        uint64_t start = BL_LE64(extents[i].Start);
+
+        if (count == 0 || block < nextBlock || count > UINT64_MAX - block) goto stale;
+        if (start != 0 && (start >= partitionBlocks || count > partitionBlocks - start)) goto stale;
+
+        BiAddExtent(file, block, count, start);
+        nextBlock = block + count;
+    }
+
+    file->Mapped = true;
+    return file;
+
+stale:
+    BlPrint("Path cache entry for %s is stale\n", path);
+    BiMaybeFreeFile(file);
+    return nullptr;
+}
+
+static struct BlFsFile *BiFindCachedFile(const char *path) {
+    if (!BiPathCache) return nullptr;
+
+    const struct BiPathCacheHeader *header = BiPathCache;
+    uint32_t entryCount = BL_LE32(header->EntryCount);
+    size_t pathLength = BlStringLength(path);
+    size_t offset = sizeof(*header);
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        const struct BiPathCacheEntry *entry = BiPathCache + offset;
+        size_t remaining = BiPathCacheSize - offset;
+        if (remaining < sizeof(*entry)) break;
+        remaining -= sizeof(*entry);
+
+        uint32_t entryPathLength = BL_LE32(entry->PathLength);
+        uint32_t inodeCount = BL_LE32(entry->InodeCount);
+        uint32_t extentCount = BL_LE32(entry->ExtentCount);
+
+        if (entryPathLength > remaining) break;
+        size_t pathSize = BL_ALIGN_UP(entryPathLength, 4u);
+        if (pathSize > remaining) break;
+        remaining -= pathSize;
+
+        if (inodeCount > remaining / sizeof(struct BiPathCacheInode)) break;
+        size_t inodesSize = inodeCount * sizeof(struct BiPathCacheInode);
+        remaining -= inodesSize;
+
+        if (extentCount > remaining / sizeof(struct BiPathCacheExtent)) break;
+        size_t extentsSize = extentCount * sizeof(struct BiPathCacheExtent);
+
+        const void *entryPath = (const void *)entry + sizeof(*entry);
+        const void *inodes = entryPath + pathSize;
+        const void *extents = inodes + inodesSize;
+
+        if (entryPathLength == pathLength && BlCompareMemory(entryPath, path, pathLength) == 0) {
+            return BiOpenCachedFile(path, inodes, inodeCount, extents, extentCount);
+        }
+
+        offset += sizeof(*entry) + pathSize + inodesSize + extentsSize;
+    }
+
+    return nullptr;
+}
+
+void BlFsLoadPathCache(void) {
+    auto file = BlFsFind(BI_PATH_CACHE_NAME);
+    if (!file) return;
+
+    uint64_t size = BlFsFileSize(file);
+
+    if (size < sizeof(struct BiPathCacheHeader) || size > BI_PATH_CACHE_MAX_SIZE) {
+        BlPrint("Ignoring path cache with invalid size\n");
+        BlFsFree(file);
+        return;
+    }
+
+    struct BiPathCacheHeader *header = BlAllocateHeap(size, _Alignof(struct BiPathCacheHeader), false);
+    BlFsFileRead(file, header, size, 0, false);
+    BlFsFree(file);
+
+    if (BL_LE32(header->Magic) != BI_PATH_CACHE_MAGIC || BL_LE32(header->Version) != BI_PATH_CACHE_VERSION) {
+        BlPrint("Ignoring path cache with unknown format\n");
+        BlFreeHeap(header);
+        return;
+    }
+
+    BiPathCache = header;
+    BiPathCacheSize = size;
 }
 
 struct BlFsFile *BlFsFind(const char *path) {
-    struct BiInode *inode = BiFindInode(&BiRoot, path, BlStringLength(path), 0);
-    if (!inode) return nullptr;
+    struct BlFsFile *file = BiFindCachedFile(path);
+    if (file) return file;
+
+    file = BiFindInode(&BiRoot, path, BlStringLength(path), 0);
+    if (!file) return nullptr;
 
-    if (BI_TYPE(inode->Mode) != BI_TYPE_REG) {
-        if (inode != &BiRoot) BlFreeHeap(inode);
+    if (BI_TYPE(file->Inode.Mode) != BI_TYPE_REG) {
+        BiMaybeFreeFile(file);
         return nullptr;
     }
 
-    return (struct BlFsFile *)inode;
+    return file;
 }
 
 uint64_t BlFsFileSize(struct BlFsFile *file) {
@@ -371,9 +1213,43 @@ void BlFsFileRead(struct BlFsFile *file, void *buffer, size_t count, uint64_t po
     uint64_t avail = position - fileSize;
     if (count > avail) return;
 
-    BiReadFromInode(&file->Inode, buffer, count, position, bypassCache);
+    BiReadFromInode(file, buffer, count, position, bypassCache);
+}
+
+size_t BlFsFileContiguousLength(struct BlFsFile *file, uint64_t position, size_t count) {
+    uint64_t fileSize = BiInodeSize(&file->Inode);
+    if (position >= fileSize) return 0;
+    if (count > fileSize - position) count = fileSize - position;
+    if (!count) return 0;
+
+    uint64_t base;
+    return BiGetInodeRun(file, position, count, &base);
+}
+
+void BlFsFileStartChecksum(struct BlFsFile *file) {
+    file->Checksumming = true;
+    file->Checksum = 0;
+    file->ChecksumPosition = 0;
+}
+
+uint32_t BlFsFileFinishChecksum(struct BlFsFile *file) {
+    uint64_t fileSize = BiInodeSize(&file->Inode);
+
+    if (file->ChecksumPosition < fileSize) {
+        unsigned char *buffer = BlAllocateHeap(BI_CHECKSUM_BUFFER_SIZE, 1, false);
+
+        while (file->ChecksumPosition < fileSize) {
+            size_t count = BL_MIN(fileSize - file->ChecksumPosition, BI_CHECKSUM_BUFFER_SIZE);
+            BiReadFromInode(file, buffer, count, file->ChecksumPosition, false);
+        }
+
+        BlFreeHeap(buffer);
+    }
+
+    file->Checksumming = false;
+    return file->Checksum;
 }
 
 void BlFsFree(struct BlFsFile *file) {
-    BiMaybeFreeInode(&file->Inode);
+    BiMaybeFreeFile(file);
 }
@@ -7,7 +7,17 @@ struct BlFsFile;
 
 bool BlFsInitialize(void);
 
+// Loads the path cache stored next to the configuration file, if there is one. Paths found in it are opened without
+// being looked up, as long as none of the inodes they were resolved through have changed since it was written.
+void BlFsLoadPathCache(void);
+
 struct BlFsFile *BlFsFind(const char *path);
 uint64_t BlFsFileSize(struct BlFsFile *file);
 void BlFsFileRead(struct BlFsFile *file, void *buffer, size_t count, uint64_t position, bool bypassCache);
+size_t BlFsFileContiguousLength(struct BlFsFile *file, uint64_t position, size_t count);
+
+// Starts computing the CRC32C of the file as it gets read, so verifying it doesn't take another pass over the data.
+void BlFsFileStartChecksum(struct BlFsFile *file);
+// Returns the CRC32C of the whole file, reading any parts of it that weren't read in order since checksumming started.
+uint32_t BlFsFileFinishChecksum(struct BlFsFile *file);
 void BlFsFree(struct BlFsFile *file);
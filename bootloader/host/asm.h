@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+
+static inline size_t BlReadWhami(void) {
+    return 0;
+}
+
+static inline size_t BlAtomicFetchAdd(size_t *ptr, size_t value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+static inline void BlSpinPause(void) {
+}
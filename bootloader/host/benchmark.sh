@@ -0,0 +1,27 @@
+#!/bin/sh
+# Boots the given kernel and initrd with the host platform from ext2 images with 1 KiB and 4 KiB blocks, and prints
+# the statistics of each run. Small blocks put more of a large file behind indirect blocks, so both are measured. Each
+# is booted with and without CRC32C sidecars, to show what verifying them costs.
+# Usage: benchmark.sh BOOTLOADER KERNEL [INITRD]
+set -e
+
+if [ $# -lt 2 ] || [ $# -gt 3 ]; then
+    echo "usage: $0 BOOTLOADER KERNEL [INITRD]" >&2
+    exit 1
+fi
+
+bootloader=$1
+kernel=$2
+initrd=$3
+
+image=$(mktemp)
+trap 'rm -f "$image"' EXIT
+
+for blockSize in 1024 4096; do
+    for checksums in 0 1; do
+        CHECKSUMS=$checksums "$(dirname "$0")/mkimage.sh" "$image" "$kernel" "$initrd" "$blockSize"
+
+        echo "== $blockSize-byte blocks, $([ $checksums = 1 ] && echo with || echo without) checksums"
+        "$bootloader" "$image" | grep -v -e '^Searching' -e '^Loading' -e '^Placing' -e '^Creating' -e '^Starting'
+    done
+done
@@ -0,0 +1,97 @@
+// Builds a device tree with thousands of nodes through the bootloader's own dt.c, and reports how long adding the
+// nodes and building the blob took and how much heap that needed. Real trees are much smaller, so this is about how
+// the costs grow rather than what a boot pays for them.
+
+#include "dt.h"
+#include "main.h"
+#include "memory.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define BX_HEAP_SIZE 0x1000'0000
+#define BX_FRAGMENT_COUNT 512
+
+struct BiKernelHeader BlKernelHeader;
+
+_Noreturn void BxReturnToFirmware(void) {
+    fflush(stdout);
+    exit(EXIT_FAILURE);
+}
+
+void BxPrintString(const char *) {
+}
+
+static double BxMilliseconds(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// gives the heap some holes, like the bootloader's has by the time it builds the tree
+static void BxFragmentHeap(void) {
+    void *blocks[BX_FRAGMENT_COUNT];
+
+    for (size_t i = 0; i < BX_FRAGMENT_COUNT; i++) blocks[i] = BlAllocateHeap(64 + (i * 37) % 900, 8, false);
+    for (size_t i = 0; i < BX_FRAGMENT_COUNT; i += 2) BlFreeHeap(blocks[i]);
+}
+
+// six properties per node, with the names of some of them spread over a few hundred distinct strings
+static void BxAddNodes(struct BlDtNode *parent, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        char name[32], compatible[32], property[32];
+        snprintf(name, sizeof(name), "device@%zx", i << 12);
+        snprintf(compatible, sizeof(compatible), "xrarch,device-%zu", i % 50);
+        snprintf(property, sizeof(property), "xrarch,property-%zu", i % 300);
+
+        auto node = BlDtCreateNode(parent, name);
+        uint32_t reg[] = {i << 12, 0x100};
+
+        BlDtAddPropertyU32s(node, "reg", reg, 2);
+        BlDtAddPropertyString(node, "compatible", compatible);
+        BlDtAddPropertyU32(node, "interrupts", i);
+        BlDtAddPropertyU32(node, "interrupt-parent", 1);
+        BlDtAddPropertyString(node, "status", "okay");
+        BlDtAddProperty(node, property, nullptr, 0);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [NODES]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 0) : 4000;
+
+    // the bootloader stores heap addresses in 32-bit device tree cells
+    void *heap = mmap(nullptr, BX_HEAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+    if (heap == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    BlAddHeapRange((uintptr_t)heap, BX_HEAP_SIZE);
+    BxFragmentHeap();
+
+    struct timespec start, built, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    BlDtAddPropertyU32(nullptr, "#address-cells", 1);
+    BlDtAddPropertyU32(nullptr, "#size-cells", 1);
+    BxAddNodes(BlDtCreateNode(nullptr, "soc"), count);
+    clock_gettime(CLOCK_MONOTONIC, &built);
+
+    uint32_t *blob = BlDtBuildBlob();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("Nodes: %zu\n", count);
+    printf("Adding nodes: %.3f ms\n", BxMilliseconds(&start, &built));
+    printf("Building blob: %.3f ms\n", BxMilliseconds(&built, &end));
+    printf("Blob size: %u\n", __builtin_bswap32(blob[1]));
+    printf("Peak heap usage: %zu\n", BlGetHeapPeakUsage());
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+// Runs the bootloader as a Linux process, with the boot disk backed by an image file. Instead of starting the
+// kernel, it reports how much work loading it took, so bootloader changes can be measured without an emulator.
+
+#include "config.h"
+#include "main.h"
+#include "memory.h"
+#include "platform.h"
+#include "platformdefs.h"
+#include "transition.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define BX_DEFAULT_HEAP_SIZE 0x200'0000
+
+size_t BxNumCpus = 1;
+
+static FILE *BxDiskImage;
+static uint64_t BxDiskSectors;
+static size_t BxFirmwareCalls;
+static uint64_t BxBytesRead;
+static struct timespec BxStartTime;
+static void *BxHeap;
+static size_t BxHeapSize;
+
+_Noreturn void BxReturnToFirmware(void) {
+    fflush(stdout);
+    exit(EXIT_FAILURE);
+}
+
+void BxPrintString(const char *str) {
+    fputs(str, stdout);
+}
+
+uint64_t BxGetTimeMs(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_REALTIME, &time);
+    return (uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000'000;
+}
+
+uint32_t BxBootDiskIndex(void) {
+    return 0;
+}
+
+bool BxReadFromDisk(void *buffer, uint64_t sector, size_t count) {
+    if ((uintptr_t)buffer & BL_SECTOR_MASK) {
+        fprintf(stderr, "BxReadFromDisk: unaligned buffer\n");
+        BxReturnToFirmware();
+    }
+
+    uint64_t end = sector + count;
+    if (end < sector) return false;
+    if (end > BxDiskSectors) end = BxDiskSectors;
+
+    BxFirmwareCalls += 1;
+    BxBytesRead += (end - sector) << BL_SECTOR_SHIFT;
+
+    if (fseeko(BxDiskImage, sector << BL_SECTOR_SHIFT, SEEK_SET)) return false;
+    return fread(buffer, BL_SECTOR_SIZE, end - sector, BxDiskImage) == end - sector;
+}
+
+void BxRunOnOtherCpus(void (*)(void *), void *) {
+}
+
+// the heap is the only memory the bootloader knows about here
+void BxForEachMemoryRange(void (*func)(uintptr_t base, size_t size, void *ctx), void *ctx) {
+    func((uintptr_t)BxHeap, BxHeapSize, ctx);
+}
+
+_Noreturn void BlTransition(uintptr_t, void *, size_t, size_t) {
+    struct timespec endTime;
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+    double milliseconds = (endTime.tv_sec - BxStartTime.tv_sec) * 1e3 + (endTime.tv_nsec - BxStartTime.tv_nsec) / 1e6;
+
+    printf("Firmware calls: %zu\n", BxFirmwareCalls);
+    printf("Bytes read: %llu\n", (unsigned long long)BxBytesRead);
+    printf("Peak heap usage: %zu\n", BlGetHeapPeakUsage());
+    printf("Wall time: %.3f ms\n", milliseconds);
+
+    exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "usage: %s IMAGE [HEAP-MIB [COMMAND-LINE]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    BxDiskImage = fopen(argv[1], "rb");
+
+    if (!BxDiskImage || fseeko(BxDiskImage, 0, SEEK_END)) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    BxDiskSectors = ftello(BxDiskImage) >> BL_SECTOR_SHIFT;
+
+    size_t heapSize = argc > 2 ? strtoul(argv[2], nullptr, 0) << 20 : BX_DEFAULT_HEAP_SIZE;
+    if (argc > 3) BlCommandLine = argv[3];
+
+    // the bootloader stores heap addresses in 32-bit page table entries and device tree cells
+    void *heap = mmap(nullptr, heapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+    if (heap == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    BxHeap = heap;
+    BxHeapSize = heapSize;
+    BlAddHeapRange((uintptr_t)heap, heapSize);
+
+    clock_gettime(CLOCK_MONOTONIC, &BxStartTime);
+    BlMain();
+}
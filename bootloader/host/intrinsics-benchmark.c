@@ -0,0 +1,149 @@
+// Compares the throughput of the bootloader's memcpy, memmove, memset, memcmp and strlen with the byte loops they
+// replaced, for the buffer sizes the bootloader mostly works with. Both run on the host, so only the ratio between
+// them means anything.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BX_TOTAL_BYTES 0x1000'0000
+#define BX_BUFFER_SIZE 0x2000
+
+static void *BxByteCopy(void *restrict dest, const void *restrict src, size_t count) {
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+
+    while (count--) *d++ = *s++;
+
+    return dest;
+}
+
+static void *BxByteMove(void *dest, const void *src, size_t count) {
+    unsigned char *d = dest;
+    const unsigned char *s = src;
+
+    if ((uintptr_t)d < (uintptr_t)s) {
+        while (count--) *d++ = *s++;
+    } else {
+        d += count;
+        s += count;
+
+        while (count--) *--d = *--s;
+    }
+
+    return dest;
+}
+
+static void *BxByteFill(void *dest, int value, size_t count) {
+    unsigned char *d = dest;
+    unsigned char f = value;
+
+    while (count--) *d++ = f;
+
+    return dest;
+}
+
+static int BxByteCompare(const void *s1, const void *s2, size_t count) {
+    const unsigned char *b1 = s1;
+    const unsigned char *b2 = s2;
+
+    while (count--) {
+        int diff = *b1++ - *b2++;
+        if (diff != 0) return diff;
+    }
+
+    return 0;
+}
+
+static size_t BxByteLength(const char *str) {
+    size_t length = 0;
+    while (*str++) length++;
+    return length;
+}
+
+struct BxFunctions {
+    void *(*Copy)(void *restrict, const void *restrict, size_t);
+    void *(*Move)(void *, const void *, size_t);
+    void *(*Fill)(void *, int, size_t);
+    int (*Compare)(const void *, const void *, size_t);
+    size_t (*Length)(const char *);
+};
+
+enum BxOperation {
+    BX_COPY,
+    BX_COPY_MISALIGNED,
+    BX_MOVE,
+    BX_FILL,
+    BX_COMPARE,
+    BX_LENGTH,
+    BX_OPERATION_COUNT,
+};
+
+static const char *BxOperationNames[BX_OPERATION_COUNT] = {
+    [BX_COPY] = "memcpy",
+    [BX_COPY_MISALIGNED] = "memcpy+1",
+    [BX_MOVE] = "memmove",
+    [BX_FILL] = "memset",
+    [BX_COMPARE] = "memcmp",
+    [BX_LENGTH] = "strlen",
+};
+
+// called through volatile pointers so that the compiler can't inline or drop any of the calls
+static const struct BxFunctions *volatile BxBytewise =
+    &(const struct BxFunctions){BxByteCopy, BxByteMove, BxByteFill, BxByteCompare, BxByteLength};
+static const struct BxFunctions *volatile BxWordwise =
+    &(const struct BxFunctions){memcpy, memmove, memset, memcmp, strlen};
+
+static unsigned char BxSource[BX_BUFFER_SIZE + 64] __attribute__((aligned(64)));
+static unsigned char BxDest[BX_BUFFER_SIZE + 64] __attribute__((aligned(64)));
+static volatile size_t BxSink;
+
+static double BxMeasure(const struct BxFunctions *funcs, enum BxOperation op, size_t size) {
+    size_t iterations = BX_TOTAL_BYTES / size;
+
+    // strlen stops at the terminator, memcmp runs to the end of two equal buffers
+    memset(BxSource, 'x', sizeof(BxSource));
+    BxSource[size] = 0;
+    memcpy(BxDest, BxSource, sizeof(BxDest));
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < iterations; i++) {
+        switch (op) {
+        case BX_COPY: funcs->Copy(BxDest, BxSource, size); break;
+        case BX_COPY_MISALIGNED: funcs->Copy(BxDest, BxSource + 1, size); break;
+        case BX_MOVE: funcs->Move(BxDest + 8, BxDest, size); break;
+        case BX_FILL: funcs->Fill(BxDest, (int)i, size); break;
+        case BX_COMPARE: BxSink = funcs->Compare(BxDest, BxSource, size); break;
+        case BX_LENGTH: BxSink = funcs->Length((const char *)BxSource); break;
+        case BX_OPERATION_COUNT: break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)iterations * size / seconds / (1 << 20);
+}
+
+int main(void) {
+    static const size_t sizes[] = {16, 512, 4096};
+
+    printf("%-5s %-9s %12s %12s %8s\n", "size", "function", "bytes MiB/s", "words MiB/s", "speedup");
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        for (enum BxOperation op = 0; op < BX_OPERATION_COUNT; op++) {
+            double bytewise = BxMeasure(BxBytewise, op, sizes[i]);
+            double wordwise = BxMeasure(BxWordwise, op, sizes[i]);
+
+            printf("%-5zu %-9s %12.0f %12.0f %7.1fx\n", sizes[i], BxOperationNames[op], bytewise, wordwise,
+                   wordwise / bytewise);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Creates a disk image with a single ext2 partition containing the given kernel and initrd, for use with the host
+# platform. Usage: mkimage.sh OUTPUT KERNEL [INITRD [BLOCK-SIZE]]
+# With CHECKSUMS=1 in the environment, CRC32C sidecars are written next to the kernel and initrd.
+set -e
+
+if [ $# -lt 2 ] || [ $# -gt 4 ]; then
+    echo "usage: $0 OUTPUT KERNEL [INITRD [BLOCK-SIZE]]" >&2
+    exit 1
+fi
+
+output=$1
+kernel=$2
+initrd=$3
+blockSize=${4:-4096}
+
+root=$(mktemp -d)
+partition=$(mktemp)
+trap 'rm -rf "$root" "$partition"' EXIT
+
+crc32c() {
+    python3 -c '
+import sys
+table = []
+for i in range(256):
+    for _ in range(8): i = (i >> 1) ^ (0x82f63b78 if i & 1 else 0)
+    table.append(i)
+crc = 0xffffffff
+for byte in open(sys.argv[1], "rb").read(): crc = table[(crc ^ byte) & 0xff] ^ (crc >> 8)
+print("%08x" % (crc ^ 0xffffffff))
+' "$1"
+}
+
+mkdir "$root/boot"
+cp "$kernel" "$root/boot/linux"
+echo "KernelPath: /boot/linux" > "$root/xrlinux.cfg"
+[ "$CHECKSUMS" = 1 ] && crc32c "$kernel" > "$root/boot/linux.crc32c"
+
+if [ -n "$initrd" ]; then
+    cp "$initrd" "$root/boot/initrd"
+    echo "InitrdPath: /boot/initrd" >> "$root/xrlinux.cfg"
+    [ "$CHECKSUMS" = 1 ] && crc32c "$initrd" > "$root/boot/initrd.crc32c"
+fi
+
+# leave a quarter of the partition free, plus some room for metadata
+size=$(du -sk "$root" | cut -f1)
+size=$((size + size / 4 + 1024))
+mke2fs -q -F -t ext2 -b "$blockSize" -d "$root" "$partition" "${size}k"
+
+le32() {
+    value=$1
+    for _ in 1 2 3 4; do
+        printf "\\$(printf %03o $((value & 255)))"
+        value=$((value >> 8))
+    done
+}
+
+# the partition starts at 1M, as fdisk would place it
+start=2048
+sectors=$(($(wc -c < "$partition") / 512))
+
+dd if=/dev/zero of="$output" bs=512 count=$start status=none
+{ printf '\200\0\0\0\203\0\0\0'; le32 $start; le32 $sectors; } | dd of="$output" bs=1 seek=446 conv=notrunc status=none
+printf '\125\252' | dd of="$output" bs=1 seek=510 conv=notrunc status=none
+cat "$partition" >> "$output"
@@ -2,10 +2,50 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// Bulk operations work a word at a time. Only aligned words are ever accessed, so reading past the end of a buffer
+// (as strlen does) never crosses into another page. Words may alias anything.
+typedef size_t __attribute__((may_alias)) BiWord;
+
+#define BI_WORD_SIZE sizeof(BiWord)
+#define BI_WORD_MASK (BI_WORD_SIZE - 1)
+#define BI_WORD_BITS (BI_WORD_SIZE * 8)
+
+// below this, the setup for the word loops costs more than it saves
+#define BI_WORD_THRESHOLD (BI_WORD_SIZE * 2)
+
+#define BI_ONES ((BiWord)-1 / 0xff)
+#define BI_HIGHS (BI_ONES * 0x80)
+
+// combines the bytes at `shift / 8` onwards of `low` with the bytes before that of `high`
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define BI_MERGE_WORDS(low, high, shift) (((low) >> (shift)) | ((high) << (BI_WORD_BITS - (shift))))
+#else
+#define BI_MERGE_WORDS(low, high, shift) (((low) << (shift)) | ((high) >> (BI_WORD_BITS - (shift))))
+#endif
+
+static bool BiHasZeroByte(BiWord word) {
+    return ((word - BI_ONES) & ~word & BI_HIGHS) != 0;
+}
+
 BL_USED int memcmp(const void *s1, const void *s2, size_t count) {
     const unsigned char *b1 = s1;
     const unsigned char *b2 = s2;
 
+    // skip over equal words, the differing byte (if any) is found below
+    if (count >= BI_WORD_THRESHOLD && (((uintptr_t)b1 ^ (uintptr_t)b2) & BI_WORD_MASK) == 0) {
+        while ((uintptr_t)b1 & BI_WORD_MASK) {
+            int diff = *b1++ - *b2++;
+            if (diff != 0) return diff;
+            count--;
+        }
+
+        while (count >= BI_WORD_SIZE && *(const BiWord *)b1 == *(const BiWord *)b2) {
+            b1 += BI_WORD_SIZE;
+            b2 += BI_WORD_SIZE;
+            count -= BI_WORD_SIZE;
+        }
+    }
+
     while (count--) {
         int c1 = *b1++;
         int c2 = *b2++;
@@ -17,12 +57,86 @@ BL_USED int memcmp(const void *s1, const void *s2, size_t count) {
     return 0;
 }
 
-BL_USED void *memcpy(void *restrict dest, const void *restrict src, size_t count) {
-    unsigned char *d = dest;
-    const unsigned char *s = src;
+// Also used by memmove when `dest` is below `src`: every source word is read before the destination word that
+// overlaps it is written.
+static void BiCopyForward(unsigned char *d, const unsigned char *s, size_t count) {
+    if (count >= BI_WORD_THRESHOLD) {
+        while ((uintptr_t)d & BI_WORD_MASK) {
+            *d++ = *s++;
+            count--;
+        }
+
+        BiWord *wd = (BiWord *)d;
+        size_t words = count / BI_WORD_SIZE;
+        size_t offset = (uintptr_t)s & BI_WORD_MASK;
+
+        if (offset == 0) {
+            const BiWord *ws = (const BiWord *)s;
+
+            for (; words >= 4; words -= 4) {
+                BiWord w0 = ws[0];
+                BiWord w1 = ws[1];
+                BiWord w2 = ws[2];
+                BiWord w3 = ws[3];
+                wd[0] = w0;
+                wd[1] = w1;
+                wd[2] = w2;
+                wd[3] = w3;
+                ws += 4;
+                wd += 4;
+            }
+
+            while (words--) *wd++ = *ws++;
+        } else {
+            // the source is misaligned, so build each destination word out of two aligned source words
+            const BiWord *ws = (const BiWord *)(s - offset);
+            unsigned shift = offset * 8;
+            BiWord low = *ws++;
+
+            for (; words >= 2; words -= 2) {
+                BiWord mid = ws[0];
+                BiWord high = ws[1];
+                wd[0] = BI_MERGE_WORDS(low, mid, shift);
+                wd[1] = BI_MERGE_WORDS(mid, high, shift);
+                low = high;
+                ws += 2;
+                wd += 2;
+            }
+
+            if (words != 0) *wd = BI_MERGE_WORDS(low, *ws, shift);
+        }
+
+        size_t bulk = count & ~BI_WORD_MASK;
+        d += bulk;
+        s += bulk;
+        count -= bulk;
+    }
 
     while (count--) *d++ = *s++;
+}
+
+// `d` and `s` point to the end of their buffers
+static void BiCopyBackward(unsigned char *d, const unsigned char *s, size_t count) {
+    if (count >= BI_WORD_THRESHOLD && (((uintptr_t)d ^ (uintptr_t)s) & BI_WORD_MASK) == 0) {
+        while ((uintptr_t)d & BI_WORD_MASK) {
+            *--d = *--s;
+            count--;
+        }
+
+        BiWord *wd = (BiWord *)d;
+        const BiWord *ws = (const BiWord *)s;
+
+        for (; count >= BI_WORD_SIZE; count -= BI_WORD_SIZE) *--wd = *--ws;
 
+        d = (unsigned char *)wd;
+        s = (const unsigned char *)ws;
+    }
+
+    while (count--) *--d = *--s;
+}
+
+BL_USED void *memcpy(void *restrict dest, const void *restrict src, size_t count) {
+    BiCopyForward(dest, src, count);
     return dest;
 }
 
@@ -30,13 +144,11 @@ BL_USED void *memmove(void *dest, const void *src, size_t count) {
     unsigned char *d = dest;
     const unsigned char *s = src;
 
-    if ((uintptr_t)d < (uintptr_t)s) {
-        while (count--) *d++ = *s++;
+    // a forward copy is safe unless the destination starts inside the source
+    if ((uintptr_t)d - (uintptr_t)s >= count) {
+        BiCopyForward(d, s, count);
     } else {
-        d += count;
-        s += count;
-
-        while (count--) *--d = *--s;
+        BiCopyBackward(d + count, s + count, count);
     }
 
     return dest;
@@ -46,6 +158,30 @@ BL_USED void *memset(void *dest, int value, size_t count) {
     unsigned char *d = dest;
     unsigned char f = value;
 
+    if (count >= BI_WORD_THRESHOLD) {
+        while ((uintptr_t)d & BI_WORD_MASK) {
+            *d++ = f;
+            count--;
+        }
+
+        BiWord *wd = (BiWord *)d;
+        BiWord pattern = BI_ONES * f;
+        size_t words = count / BI_WORD_SIZE;
+
+        for (; words >= 4; words -= 4) {
+            wd[0] = pattern;
+            wd[1] = pattern;
+            wd[2] = pattern;
+            wd[3] = pattern;
+            wd += 4;
+        }
+
+        while (words--) *wd++ = pattern;
+
+        d = (unsigned char *)wd;
+        count &= BI_WORD_MASK;
+    }
+
     while (count--) *d++ = f;
 
     return dest;
@@ -63,7 +199,18 @@ BL_USED int strcmp(const char *s1, const char *s2) {
 }
 
 BL_USED size_t strlen(const char *str) {
-    size_t length = 0;
-    while (*str++) length++;
-    return length;
+    const char *s = str;
+
+    while ((uintptr_t)s & BI_WORD_MASK) {
+        if (*s == 0) return s - str;
+        s++;
+    }
+
+    const BiWord *w = (const BiWord *)s;
+    while (!BiHasZeroByte(*w)) w++;
+
+    s = (const char *)w;
+    while (*s) s++;
+
+    return s - str;
 }
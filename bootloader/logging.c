@@ -1,11 +1,95 @@
 #include "logging.h"
 #include "compiler.h"
+#include "config.h"
+#include "dt.h"
+#include "paging.h"
 #include "platform.h"
 #include <stddef.h>
+#include <stdint.h>
 
 #define BI_MAX_DIGITS 32
 
+// firmware calls are slow, so console output is handed over a line at a time
+#define BI_LINE_SIZE 128
+
+#define BI_LOG_SIZE 0x4000
+#define BI_LOG_MAGIC 0x474f4c58
+
+// Everything printed is also kept here, whether or not the console is quiet. The kernel finds it through
+// /reserved-memory; all fields are little-endian.
+struct BiLog {
+    uint32_t Magic;
+    uint32_t Size;
+    uint32_t Written;
+    uint32_t Reserved;
+    unsigned char Data[BI_LOG_SIZE - 16];
+};
+
+static struct BiLog BiLog __attribute__((aligned(BL_PAGE_SIZE)));
+static size_t BiLogWritten;
+static size_t BiLogPosition;
+
+// the value of BiLogWritten when the first character was kept out of the console
+static size_t BiLogSuppressed = SIZE_MAX;
+
+static char BiLine[BI_LINE_SIZE];
+static size_t BiLineLength;
+
+static void BiFlushLine(void) {
+    if (BiLineLength == 0) return;
+
+    BiLine[BiLineLength] = 0;
+    BxPrintString(BiLine);
+    BiLineLength = 0;
+}
+
+static void BiConsoleCharacter(unsigned char c) {
+    BiLine[BiLineLength++] = c;
+    if (c == '\n' || BiLineLength == sizeof(BiLine) - 1) BiFlushLine();
+}
+
+static void BiLogCharacter(unsigned char c) {
+    BiLog.Data[BiLogPosition++] = c;
+    if (BiLogPosition == sizeof(BiLog.Data)) BiLogPosition = 0;
+
+    BiLogWritten += 1;
+    BiLog.Written = BL_LE32(BiLogWritten);
+}
+
+// prints everything that was kept out of the console so far, as far as it is still in the ring
+static void BiReplayLog(void) {
+    if (BiLogSuppressed == SIZE_MAX) return;
+
+    size_t count = BL_MIN(BiLogWritten - BiLogSuppressed, sizeof(BiLog.Data));
+    size_t start = BiLogPosition >= count ? BiLogPosition - count : BiLogPosition + sizeof(BiLog.Data) - count;
+
+    for (size_t i = 0; i < count; i++) {
+        BiConsoleCharacter(BiLog.Data[start++]);
+        if (start == sizeof(BiLog.Data)) start = 0;
+    }
+}
+
+void BlDtAddBootLog(void) {
+    BiLog.Magic = BL_LE32(BI_LOG_MAGIC);
+    BiLog.Size = BL_LE32(sizeof(BiLog.Data));
+
+    // the log stays where it is, so whatever is printed after the blob is built still reaches the kernel
+    uint64_t reg[] = {(uintptr_t)&BiLog, sizeof(BiLog)};
+    char name[32];
+    BlPrintToBuffer(name, sizeof(name), "boot-log@%zx", (uintptr_t)&BiLog);
+
+    auto node = BlDtCreateNode(BlDtGetReservedMemoryNode(), name);
+    BlDtAddPropertyString(node, "compatible", "xrlinux,boot-log");
+    BlDtAddPropertyReg(node, reg, 1);
+}
+
 _Noreturn void BlCrash(const char *format, ...) {
+    // a quiet boot that fails shouldn't fail silently
+    if (BlQuiet) {
+        BlQuiet = false;
+        BiReplayLog();
+    }
+
     va_list args;
     va_start(args);
     BlPrint("BlCrash: %f\n", format, &args);
@@ -153,7 +237,10 @@ static void BlPrintArgsToCallback(const char *format, va_list args, void (*fn)(u
 }
 
 static void BlPrintArgsCallback(unsigned char c, void *) {
-    BxPrintCharacter(c);
+    if (!BlQuiet) BiConsoleCharacter(c);
+    else if (BiLogSuppressed == SIZE_MAX) BiLogSuppressed = BiLogWritten;
+
+    BiLogCharacter(c);
 }
 
 void BlPrintArgs(const char *format, va_list args) {
@@ -8,3 +8,6 @@ void BlPrint(const char *format, ...);
 void BlPrintArgs(const char *format, va_list args);
 size_t BlPrintToBuffer(void *buffer, size_t size, const char *format, ...);
 size_t BlPrintArgsToBuffer(void *buffer, size_t size, const char *format, va_list args);
+
+// reserves the boot log for the kernel; must be called before the device tree blob is built
+void BlDtAddBootLog(void);
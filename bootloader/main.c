@@ -1,6 +1,7 @@
 #include "main.h"
 #include "compiler.h"
 #include "config.h"
+#include "decompress.h"
 #include "dt.h"
 #include "filesystem.h"
 #include "logging.h"
@@ -8,11 +9,18 @@
 #include "paging.h"
 #include "partition.h"
 #include "platform.h"
+#include "platformdefs.h"
+#include "timing.h"
 #include "transition.h"
+#include "workqueue.h"
 
 #define BI_PROTOCOL_MAGIC 0x584c5258
 #define BI_PROTOCOL_MAJOR 2
-#define BI_PROTOCOL_MINOR 0
+#define BI_PROTOCOL_MINOR 2
+
+#define BI_MAX_READ_SIZE 0x10'0000u
+
+#define BI_CHECKSUM_SUFFIX ".crc32c"
 
 struct BiKernelHeader BlKernelHeader;
 
@@ -20,52 +28,88 @@ static bool BiRangesOverlap(uint32_t a0, uint32_t a1, uint32_t b0, uint32_t b1)
     return a0 <= b1 && b0 <= a1;
 }
 
-static void BiLoadKernel(void) {
-    BlPrint("Loading kernel from %s\n", BlKernelPath);
+static int BiHexDigitValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
 
-    struct BlFsFile *file = BlFsFind(BlKernelPath);
-    if (!file) BlCrash("failed to open kernel file");
+// If `path` has a sidecar file containing its CRC32C in hexadecimal, the checksum of `file` is computed while it's
+// being loaded, and checked by BiVerifyChecksum afterwards.
+static bool BiStartChecksum(const char *path, struct BlFsFile *file, uint32_t *expected) {
+    size_t length = BlStringLength(path);
+    auto sidecarPath = BL_ALLOCATE(char, length + sizeof(BI_CHECKSUM_SUFFIX));
+    BlCopyMemory(sidecarPath, path, length);
+    BlCopyMemory(sidecarPath + length, BI_CHECKSUM_SUFFIX, sizeof(BI_CHECKSUM_SUFFIX));
+
+    auto sidecar = BlFsFind(sidecarPath);
+    if (!sidecar) {
+        BlFreeHeap(sidecarPath);
+        return false;
+    }
 
-    BlFsFileRead(file, &BlKernelHeader, sizeof(BlKernelHeader), 0, false);
-    if (BL_LE32(BlKernelHeader.Magic) != BI_PROTOCOL_MAGIC) BlCrash("invalid magic number");
+    char text[16];
+    size_t size = BL_MIN(BlFsFileSize(sidecar), sizeof(text));
+    BlFsFileRead(sidecar, text, size, 0, false);
+    BlFsFree(sidecar);
 
-    BlKernelHeader.MinorVersion = BL_LE16(BlKernelHeader.MinorVersion);
-    BlKernelHeader.MajorVersion = BL_LE16(BlKernelHeader.MajorVersion);
+    uint32_t value = 0;
+    size_t digits = 0;
 
-    if (BlKernelHeader.MajorVersion != BI_PROTOCOL_MAJOR) BlCrash("unsupported major version");
+    while (digits < size && BiHexDigitValue(text[digits]) >= 0) {
+        value = (value << 4) | BiHexDigitValue(text[digits++]);
+    }
 
-    BlKernelHeader.VirtualAddr = BL_LE32(BlKernelHeader.VirtualAddr);
-    BlKernelHeader.MSize = BL_LE32(BlKernelHeader.MSize);
-    BlKernelHeader.Entry = BL_LE32(BlKernelHeader.Entry);
-    BlKernelHeader.Flags = BL_LE32(BlKernelHeader.Flags);
-    BlKernelHeader.DtbAddress = BL_LE32(BlKernelHeader.DtbAddress);
-    BlKernelHeader.MaxDtbEnd = BL_LE32(BlKernelHeader.MaxDtbEnd);
+    // only trailing whitespace may follow the digits
+    bool valid = digits != 0 && digits <= 8;
 
-    if (BlKernelHeader.Entry < BlKernelHeader.VirtualAddr ||
-        BlKernelHeader.Entry - BlKernelHeader.VirtualAddr >= BlKernelHeader.MSize) {
-        BlCrash("kernel entry point outside kernel image");
+    for (size_t i = digits; i < size; i++) {
+        if (text[i] != ' ' && text[i] != '\t' && text[i] != '\r' && text[i] != '\n') valid = false;
     }
 
-    if (BlKernelHeader.Flags & BL_FLAG_MAP_DTB) {
-        BlKernelHeader.DtbAddress = BL_ALIGN_UP(BlKernelHeader.DtbAddress, BL_PAGE_SIZE);
+    if (!valid) BlCrash("invalid checksum in %s", sidecarPath);
 
-        if (BlKernelHeader.MaxDtbEnd <= BlKernelHeader.DtbAddress) {
-            BlCrash("device tree mapping area has negative size");
-        }
+    BlFreeHeap(sidecarPath);
+    BlFsFileStartChecksum(file);
+    *expected = value;
+    return true;
+}
 
-        if (BiRangesOverlap(
-                BlKernelHeader.VirtualAddr,
-                BlKernelHeader.VirtualAddr + BlKernelHeader.MSize - 1,
-                BlKernelHeader.DtbAddress,
-                BlKernelHeader.MaxDtbEnd
-            )) {
-            BlCrash("device tree mapping area overlaps kernel image");
-        }
+static void BiVerifyChecksum(struct BlFsFile *file, uint32_t expected, const char *name) {
+    uint32_t actual = BlFsFileFinishChecksum(file);
+    if (actual != expected) BlCrash("%s checksum mismatch (expected %08x, got %08x)", name, expected, actual);
+}
+
+static void BiMapKernelPages(uintptr_t virt, void *buffer, size_t size) {
+    for (size_t offset = 0; offset < size; offset += BL_PAGE_SIZE) {
+        BlMapPage(virt + offset, (uintptr_t)buffer + offset);
     }
+}
+
+// With a contiguous region, the whole file is read straight into place with one disk transfer per extent, and the BSS
+// is cleared in one go. `region` covers the image rounded out to page boundaries.
+static void BiLoadContiguousKernel(struct BlFsFile *file, uint64_t fileSize, unsigned char *region) {
+    uintptr_t start = BL_ALIGN_DOWN(BlKernelHeader.VirtualAddr, BL_PAGE_SIZE);
+    size_t headCount = BlKernelHeader.VirtualAddr - start;
+    size_t size = BL_ALIGN_UP(BlKernelHeader.VirtualAddr + BlKernelHeader.MSize, BL_PAGE_SIZE) - start;
+
+    BlFillMemory(region, 0, headCount);
+    BlFsFileRead(file, region + headCount, fileSize, 0, true);
+    BlFillMemoryParallel(region + headCount + fileSize, 0, size - headCount - fileSize);
+
+    BiMapKernelPages(start, region, size);
+}
 
+static void BiLoadUncompressedKernel(struct BlFsFile *file, void *region) {
     uint64_t fileSize = BlFsFileSize(file);
     if (fileSize > BlKernelHeader.MSize) BlCrash("kernel file too large (0x%lx bytes)", fileSize);
 
+    if (region) {
+        BiLoadContiguousKernel(file, fileSize, region);
+        return;
+    }
+
     uintptr_t current = BL_ALIGN_DOWN(BlKernelHeader.VirtualAddr, BL_PAGE_SIZE);
     uintptr_t fileEnd = BlKernelHeader.VirtualAddr + fileSize;
     uintptr_t alignedFileEnd = BL_ALIGN_DOWN(fileEnd, BL_PAGE_SIZE);
@@ -89,10 +133,17 @@ static void BiLoadKernel(void) {
     }
 
     while (current < alignedFileEnd) {
-        void *buffer = BlAllocateHeap(BL_PAGE_SIZE, BL_PAGE_SIZE, true);
-        BlFsFileRead(file, buffer, BL_PAGE_SIZE, current - BlKernelHeader.VirtualAddr, true);
-        BlMapPage(current, (uintptr_t)buffer);
-        current += BL_PAGE_SIZE;
+        // read each physically contiguous run of the file with a single disk transfer
+        uint64_t position = current - BlKernelHeader.VirtualAddr;
+        size_t maxSize = BL_MIN(alignedFileEnd - current, BI_MAX_READ_SIZE);
+        size_t size = BL_ALIGN_DOWN(BlFsFileContiguousLength(file, position, maxSize), BL_PAGE_SIZE);
+        if (size == 0) size = BL_PAGE_SIZE;
+
+        void *buffer = BlAllocateHeap(size, BL_PAGE_SIZE, true);
+        BlFsFileRead(file, buffer, size, position, true);
+        BiMapKernelPages(current, buffer, size);
+
+        current += size;
     }
 
     if (current < fileEnd) {
@@ -113,10 +164,164 @@ static void BiLoadKernel(void) {
         BlMapPage(current, (uintptr_t)buffer);
         current += BL_PAGE_SIZE;
     }
+}
+
+// Decompresses the image straight into the memory that gets mapped: all at once if there's a contiguous region, and
+// page by page otherwise.
+static void BiLoadCompressedKernel(
+    struct BlDecompressor *decompressor,
+    const struct BiKernelHeader *header,
+    unsigned char *region
+) {
+    uintptr_t current = BL_ALIGN_DOWN(BlKernelHeader.VirtualAddr, BL_PAGE_SIZE);
+    uintptr_t imageEnd = BlKernelHeader.VirtualAddr + BlKernelHeader.MSize;
+    uintptr_t end = BL_ALIGN_UP(imageEnd, BL_PAGE_SIZE);
+
+    // the header has already been consumed from the stream
+    const unsigned char *headerData = (const unsigned char *)header;
+    size_t headerLeft = sizeof(*header);
+    bool finished = false;
+
+    while (current < end) {
+        size_t size = region ? end - current : BL_PAGE_SIZE;
+        unsigned char *buffer = region ? region : BlAllocateHeap(BL_PAGE_SIZE, BL_PAGE_SIZE, true);
+        size_t offset = current < BlKernelHeader.VirtualAddr ? BlKernelHeader.VirtualAddr - current : 0;
+        size_t limit = BL_MIN(imageEnd - current, size);
+
+        BlFillMemory(buffer, 0, offset);
+
+        size_t count = BL_MIN(headerLeft, limit - offset);
+        BlCopyMemory(buffer + offset, headerData, count);
+        headerData += count;
+        headerLeft -= count;
+        offset += count;
+
+        if (!finished) {
+            count = BlDecompressRead(decompressor, buffer + offset, limit - offset);
+            finished = count != limit - offset;
+            offset += count;
+        }
+
+        BlFillMemoryParallel(buffer + offset, 0, size - offset);
+
+        BiMapKernelPages(current, buffer, size);
+        current += size;
+    }
+
+    unsigned char extra;
+    if (!finished && BlDecompressRead(decompressor, &extra, sizeof(extra)) != 0) BlCrash("kernel file too large");
+}
+
+static void BiLoadKernel(void) {
+    BlPrint("Loading kernel from %s\n", BlKernelPath);
+
+    struct BlFsFile *file = BlFsFind(BlKernelPath);
+    if (!file) BlCrash("failed to open kernel file");
+
+    uint32_t checksum;
+    bool verify = BiStartChecksum(BlKernelPath, file, &checksum);
+
+    struct BlDecompressor *decompressor = BlDecompressOpen(file);
+    struct BiKernelHeader header;
+
+    if (decompressor) {
+        if (BlDecompressRead(decompressor, &header, sizeof(header)) != sizeof(header)) {
+            BlCrash("kernel file too small");
+        }
+    } else {
+        BlFsFileRead(file, &header, sizeof(header), 0, false);
+    }
+
+    BlKernelHeader = header;
+
+    if (BL_LE32(BlKernelHeader.Magic) != BI_PROTOCOL_MAGIC) BlCrash("invalid magic number");
+
+    BlKernelHeader.MinorVersion = BL_LE16(BlKernelHeader.MinorVersion);
+    BlKernelHeader.MajorVersion = BL_LE16(BlKernelHeader.MajorVersion);
+
+    if (BlKernelHeader.MajorVersion != BI_PROTOCOL_MAJOR) BlCrash("unsupported major version");
+
+    BlKernelHeader.VirtualAddr = BL_LE32(BlKernelHeader.VirtualAddr);
+    BlKernelHeader.MSize = BL_LE32(BlKernelHeader.MSize);
+    BlKernelHeader.Entry = BL_LE32(BlKernelHeader.Entry);
+    BlKernelHeader.Flags = BL_LE32(BlKernelHeader.Flags);
+    BlKernelHeader.DtbAddress = BL_LE32(BlKernelHeader.DtbAddress);
+    BlKernelHeader.MaxDtbEnd = BL_LE32(BlKernelHeader.MaxDtbEnd);
+    BlKernelHeader.LinearMapAddr = BL_LE32(BlKernelHeader.LinearMapAddr);
+
+    if (BlKernelHeader.Entry < BlKernelHeader.VirtualAddr ||
+        BlKernelHeader.Entry - BlKernelHeader.VirtualAddr >= BlKernelHeader.MSize) {
+        BlCrash("kernel entry point outside kernel image");
+    }
+
+    if (BlKernelHeader.Flags & BL_FLAG_MAP_DTB) {
+        BlKernelHeader.DtbAddress = BL_ALIGN_UP(BlKernelHeader.DtbAddress, BL_PAGE_SIZE);
+
+        if (BlKernelHeader.MaxDtbEnd <= BlKernelHeader.DtbAddress) {
+            BlCrash("device tree mapping area has negative size");
+        }
+
+        if (BiRangesOverlap(
+                BlKernelHeader.VirtualAddr,
+                BlKernelHeader.VirtualAddr + BlKernelHeader.MSize - 1,
+                BlKernelHeader.DtbAddress,
+                BlKernelHeader.MaxDtbEnd
+            )) {
+            BlCrash("device tree mapping area overlaps kernel image");
+        }
+    }
+
+    if (BlKernelHeader.Flags & BL_FLAG_MAP_LINEAR) {
+        // the linear map extends to the top of the address space, so everything else has to be below it
+        if (BlKernelHeader.LinearMapAddr & BL_PAGE_MASK) BlCrash("linear map address not page-aligned");
+
+        if (BlKernelHeader.VirtualAddr + (BlKernelHeader.MSize - 1) >= BlKernelHeader.LinearMapAddr) {
+            BlCrash("linear map area overlaps kernel image");
+        }
+
+        if ((BlKernelHeader.Flags & BL_FLAG_MAP_DTB) && BlKernelHeader.MaxDtbEnd >= BlKernelHeader.LinearMapAddr) {
+            BlCrash("linear map area overlaps device tree mapping area");
+        }
+    }
+
+    // the protocol allows the image to be scattered, but placing it in one region lets it be loaded in far fewer reads
+    uintptr_t start = BL_ALIGN_DOWN(BlKernelHeader.VirtualAddr, BL_PAGE_SIZE);
+    size_t size = BL_ALIGN_UP(BlKernelHeader.VirtualAddr + BlKernelHeader.MSize, BL_PAGE_SIZE) - start;
+    void *region = BlTryAllocateHeap(size, BL_PAGE_SIZE, true);
+
+    if (region) {
+        BlPrint("Placing kernel contiguously at %p\n", region);
+    } else {
+        BlPrint("Memory too fragmented for a contiguous kernel, placing it page by page\n");
+    }
+
+    if (decompressor) {
+        BiLoadCompressedKernel(decompressor, &header, region);
+        BlDecompressClose(decompressor);
+    } else {
+        BiLoadUncompressedKernel(file, region);
+    }
+
+    if (verify) BiVerifyChecksum(file, checksum, "kernel");
 
     BlFsFree(file);
 }
 
+static void BiMapLinearRange(uintptr_t base, size_t size, void *) {
+    uint32_t virt = BlKernelHeader.LinearMapAddr + base;
+    if (virt < BlKernelHeader.LinearMapAddr) return;
+
+    // memory that would wrap around the top of the address space is left out
+    if (size > (uint32_t)-virt) size = (uint32_t)-virt;
+
+    BlMapRange(virt, base, size);
+}
+
+static void BiMapLinear(void) {
+    BlPrint("Mapping all memory at %p\n", (void *)(uintptr_t)BlKernelHeader.LinearMapAddr);
+    BxForEachMemoryRange(BiMapLinearRange, nullptr);
+}
+
 struct BiTransitionData {
     uintptr_t entrypoint;
     void *deviceTree;
@@ -128,14 +333,49 @@ _Noreturn static void BiDoTransition(void *ptr) {
     BlTransition(data->entrypoint, data->deviceTree, BxNumCpus, BI_PROTOCOL_MINOR);
 }
 
+static void *BiLoadCompressedInitrd(struct BlDecompressor *decompressor, size_t *sizeOut) {
+    // the recorded size is only a hint, so be prepared to grow the buffer
+    size_t capacity = BL_ALIGN_UP(BL_MIN(BlDecompressedSizeHint(decompressor), SIZE_MAX / 2), BL_PAGE_SIZE);
+    if (capacity == 0) capacity = BL_PAGE_SIZE;
+
+    unsigned char *buffer = BlAllocateHeap(capacity, BL_PAGE_SIZE, false);
+    size_t size = 0;
+
+    while (true) {
+        size += BlDecompressRead(decompressor, buffer + size, capacity - size);
+        if (size != capacity) break;
+
+        unsigned char extra;
+        if (BlDecompressRead(decompressor, &extra, sizeof(extra)) == 0) break;
+
+        capacity *= 2;
+        buffer = BlResizeHeap(buffer, capacity, BL_PAGE_SIZE);
+        buffer[size++] = extra;
+    }
+
+    *sizeOut = size;
+    return BlResizeHeap(buffer, size, BL_PAGE_SIZE);
+}
+
 static void BiProcessConfig(void) {
     if (BlStdoutPath) {
         auto chosen = BlDtFindOrCreateNode(nullptr, "chosen");
         BlDtAddPropertyString(chosen, "stdout-path", BlStdoutPath);
     }
 
-    if (BlInitrdPath) {
+    if (BlInitrdPath && BlCompareStrings(BlInitrdPath, "$BootVolumeDevice") == 0) {
+        // the kernel reads the volume from disk itself, so all it needs is where to find it
+        uint32_t volume[] = {
+            BxBootDiskIndex(),
+            BlRootPartitionStart() >> BL_SECTOR_SHIFT,
+            BlRootPartitionSize() >> BL_SECTOR_SHIFT,
+        };
+
+        auto chosen = BlDtFindOrCreateNode(nullptr, "chosen");
+        BlDtAddPropertyU32s(chosen, "xrlinux,boot-volume", volume, BL_ARRAY_SIZE(volume));
+    } else if (BlInitrdPath) {
         BlPrint("Loading initrd from %s\n", BlInitrdPath);
+        BlBeginPhase(BL_PHASE_INITRD);
 
         void *ptr;
         size_t size;
@@ -147,15 +387,33 @@ static void BiProcessConfig(void) {
         } else {
             auto file = BlFsFind(BlInitrdPath);
             if (!file) BlCrash("initrd does not exist\n", BlInitrdPath);
-            size = BL_MIN(BlFsFileSize(file), SIZE_MAX);
-            ptr = BlAllocateHeap(size, BL_PAGE_SIZE, true);
-            BlFsFileRead(file, ptr, size, 0, true);
+
+            uint32_t checksum;
+            bool verify = BiStartChecksum(BlInitrdPath, file, &checksum);
+
+            auto decompressor = BlDecompressOpen(file);
+
+            if (decompressor) {
+                ptr = BiLoadCompressedInitrd(decompressor, &size);
+                BlDecompressClose(decompressor);
+            } else {
+                size = BL_MIN(BlFsFileSize(file), SIZE_MAX);
+                ptr = BlAllocateHeap(size, BL_PAGE_SIZE, true);
+                BlFsFileRead(file, ptr, size, 0, true);
+            }
+
+            if (verify) BiVerifyChecksum(file, checksum, "initrd");
+
             BlFsFree(file);
         }
 
+        BlDtReserveBootMemory((uintptr_t)ptr, size);
+
         auto chosen = BlDtFindOrCreateNode(nullptr, "chosen");
         BlDtAddPropertyU32(chosen, "linux,initrd-start", (uintptr_t)ptr);
         BlDtAddPropertyU32(chosen, "linux,initrd-end", (uintptr_t)ptr + size);
+
+        BlEndPhase(BL_PHASE_INITRD);
     }
 
     if (BlCommandLine) {
@@ -165,17 +423,37 @@ static void BiProcessConfig(void) {
 }
 
 _Noreturn void BlMain(void) {
+    BlStartTiming();
+
+    BlBeginPhase(BL_PHASE_ROOT_PARTITION);
     BlFindRootPartition();
+    BlEndPhase(BL_PHASE_ROOT_PARTITION);
+
     BiProcessConfig();
 
+    BlBeginPhase(BL_PHASE_KERNEL);
+    BlInitPageTables();
     BiLoadKernel();
+    if (BlKernelHeader.Flags & BL_FLAG_MAP_LINEAR) BiMapLinear();
+    BlEndPhase(BL_PHASE_KERNEL);
+
+    BlBeginPhase(BL_PHASE_DEVICE_TREE);
+    BlDtAddBootTimings();
+    BlDtAddBootLog();
 
     struct BiTransitionData transitionData = {
         .entrypoint = BlGetMapping(BlKernelHeader.Entry),
         .deviceTree = BlDtBuildBlob(),
     };
 
+    BlEndPhase(BL_PHASE_DEVICE_TREE);
+    BlDtUpdateBootTimings();
+
+    BlPrintDiskStatistics();
+    BlPrintHeapStatistics();
+    BlPrintBootTimings();
+
     BlPrint("Starting kernel\n");
-    BxRunOnOtherCpus(BiDoTransition, &transitionData);
+    BlRunOnOtherCpus(BiDoTransition, &transitionData);
     BiDoTransition(&transitionData);
 }
@@ -12,9 +12,11 @@ struct BiKernelHeader {
     uint32_t Flags;
     uint32_t DtbAddress;
     uint32_t MaxDtbEnd;
+    uint32_t LinearMapAddr;
 };
 
 #define BL_FLAG_MAP_DTB (1U << 0)
+#define BL_FLAG_MAP_LINEAR (1U << 1)
 
 extern struct BiKernelHeader BlKernelHeader;
 
@@ -12,8 +12,46 @@ struct HeapRange {
 
 #define HEAP_ALIGNMENT _Alignof(struct HeapRange)
 
+// free ranges are binned by the index of the highest set bit in their size
+#define BI_HEAP_BINS 32
+
 static struct BlList BlHeapRanges;
-static struct BlList BlFreeRanges;
+static struct BlList BiFreeBins[BI_HEAP_BINS];
+
+static size_t BiHeapSize;
+static size_t BiHeapFree;
+static size_t BiHeapUsage;
+static size_t BiHeapPeakUsage;
+static size_t BiHeapPermanent;
+
+static void BiAddHeapUsage(size_t size) {
+    BiHeapUsage += size;
+    if (BiHeapUsage > BiHeapPeakUsage) BiHeapPeakUsage = BiHeapUsage;
+}
+
+static size_t BiRangeSize(struct HeapRange *range) {
+    return range->End - (uintptr_t)range;
+}
+
+static size_t BiBinIndex(size_t size) {
+    return (BI_HEAP_BINS - 1) - BlCountLeadingZeroes(size);
+}
+
+static void BiInsertFree(struct HeapRange *range) {
+    size_t size = BiRangeSize(range);
+
+    range->Free = true;
+    BlListInsertAfter(&BiFreeBins[BiBinIndex(size)], nullptr, &range->FreeNode);
+    BiHeapFree += size;
+}
+
+// must be called before a free range's size changes
+static void BiRemoveFree(struct HeapRange *range) {
+    size_t size = BiRangeSize(range);
+
+    BlListRemove(&BiFreeBins[BiBinIndex(size)], &range->FreeNode);
+    BiHeapFree -= size;
+}
 
 void BlAddHeapRange(uintptr_t base, size_t size) {
     uintptr_t end = BL_ALIGN_DOWN(base + size, HEAP_ALIGNMENT);
@@ -36,79 +74,141 @@ void BlAddHeapRange(uintptr_t base, size_t size) {
     bool mergePrev = prev != nullptr && prev->Free && prev->End == base;
     bool mergeNext = next != nullptr && next->Free && end == (uintptr_t)next;
 
-    if (mergePrev && mergeNext) {
-        prev->End = next->End;
-        BlListRemove(&BlHeapRanges, &next->Node);
-        BlListRemove(&BlFreeRanges, &next->FreeNode);
-    } else if (mergePrev) {
+    if (!mergePrev && !mergeNext && end - base < sizeof(struct HeapRange)) return;
+
+    BiHeapSize += end - base;
+
+    if (mergePrev) {
+        BiRemoveFree(prev);
+
+        if (mergeNext) {
+            BiRemoveFree(next);
+            BlListRemove(&BlHeapRanges, &next->Node);
+            end = next->End;
+        }
+
         prev->End = end;
+        BiInsertFree(prev);
     } else {
         auto range = (struct HeapRange *)base;
 
         if (mergeNext) {
+            BiRemoveFree(next);
             BlListRemove(&BlHeapRanges, &next->Node);
-            BlListRemove(&BlFreeRanges, &next->FreeNode);
-            BlCopyMemoryOverlapping(range, next, sizeof(*range));
-        } else {
-            size_t available = end - base;
-            if (available < sizeof(struct HeapRange)) return;
-
-            range->End = end;
-            range->Free = true;
+            end = next->End;
         }
 
+        range->End = end;
         BlListInsertAfter(&BlHeapRanges, prev ? &prev->Node : nullptr, &range->Node);
-        BlListInsertAfter(&BlFreeRanges, nullptr, &range->FreeNode);
+        BiInsertFree(range);
     }
 }
 
-void *BlAllocateHeap(size_t size, size_t alignment, bool permanent) {
-    if (size == 0) return nullptr;
-    if (alignment < HEAP_ALIGNMENT) alignment = HEAP_ALIGNMENT;
+// Transient allocations take the first fitting range from the smallest bin that can hold them. Ranges in higher bins
+// are at least twice the size of the request, so the search almost always stops at the first range it looks at.
+static void *BiAllocateTransient(size_t size, size_t alignment) {
+    size_t headExtra = sizeof(struct HeapRange);
+
+    for (size_t bin = BiBinIndex(size + headExtra); bin < BI_HEAP_BINS; bin++) {
+        BL_LIST_FOREACH(BiFreeBins[bin], struct HeapRange, FreeNode, range) {
+            uintptr_t rangeBase = (uintptr_t)range;
+            uintptr_t rangeEnd = range->End;
+            uintptr_t valueBase = BL_ALIGN_UP(rangeBase + headExtra, alignment);
+
+            // padding too small to hold a free range would be lost for good, and would keep the ranges around it
+            // from ever being merged again
+            if (valueBase != rangeBase + headExtra && valueBase - rangeBase < headExtra * 2) {
+                valueBase = BL_ALIGN_UP(rangeBase + headExtra * 2, alignment);
+            }
+
+            uintptr_t allocBase = valueBase - headExtra;
+            uintptr_t allocEnd = valueBase + size;
+
+            if (allocEnd < allocBase || allocBase < rangeBase || allocEnd > rangeEnd) continue;
+
+            BiRemoveFree(range);
+
+            if (rangeEnd - allocEnd >= sizeof(*range)) {
+                auto newRange = (struct HeapRange *)allocEnd;
+                newRange->End = rangeEnd;
+                BlListInsertAfter(&BlHeapRanges, &range->Node, &newRange->Node);
+                BiInsertFree(newRange);
+            } else {
+                allocEnd = rangeEnd;
+            }
+
+            auto anchor = range;
+
+            if (allocBase - rangeBase >= sizeof(*range)) {
+                range->End = allocBase;
+                BiInsertFree(range);
+                BiAddHeapUsage(allocEnd - allocBase);
+            } else {
+                anchor = BL_LIST_PREV(struct HeapRange, Node, *range);
+                BlListRemove(&BlHeapRanges, &range->Node);
+                BiAddHeapUsage(allocEnd - rangeBase);
+            }
 
-    size = BL_ALIGN_UP(size, HEAP_ALIGNMENT);
+            auto newRange = (struct HeapRange *)allocBase;
+            newRange->End = allocEnd;
+            newRange->Free = false;
+            BlListInsertAfter(&BlHeapRanges, anchor ? &anchor->Node : nullptr, &newRange->Node);
 
-    size_t headExtra = permanent ? 0 : sizeof(struct HeapRange);
+            return (void *)valueBase;
+        }
+    }
+
+    return nullptr;
+}
+
+// Permanent allocations are never freed, so they don't get a header. They're bumped down from the top of the highest
+// free range, which keeps them contiguous and away from the transient allocations made from the bottom of the heap.
+static void *BiAllocatePermanent(size_t size, size_t alignment) {
+    for (auto range = BL_LIST_TAIL(struct HeapRange, Node, BlHeapRanges); range != nullptr;
+         range = BL_LIST_PREV(struct HeapRange, Node, *range)) {
+        if (!range->Free) continue;
 
-    BL_LIST_FOREACH(BlFreeRanges, struct HeapRange, FreeNode, range) {
         uintptr_t rangeBase = (uintptr_t)range;
         uintptr_t rangeEnd = range->End;
-        uintptr_t valueBase = BL_ALIGN_UP(rangeBase + headExtra, alignment);
-        uintptr_t allocBase = valueBase - headExtra;
-        uintptr_t allocEnd = valueBase + size;
 
-        if (allocEnd < allocBase || allocBase < rangeBase || allocEnd >= rangeEnd) continue;
+        if (rangeEnd - rangeBase < size) continue;
 
-        if (rangeEnd - allocEnd >= sizeof(*range)) {
-            auto newRange = (struct HeapRange *)allocEnd;
-            newRange->End = rangeEnd;
-            newRange->Free = true;
-            BlListInsertAfter(&BlHeapRanges, &range->Node, &newRange->Node);
-            BlListInsertAfter(&BlFreeRanges, &range->FreeNode, &newRange->FreeNode);
-        } else {
-            allocEnd = rangeEnd;
-        }
+        uintptr_t allocBase = BL_ALIGN_DOWN(rangeEnd - size, alignment);
+        if (allocBase < rangeBase) continue;
+
+        BiRemoveFree(range);
 
         if (allocBase - rangeBase >= sizeof(*range)) {
             range->End = allocBase;
+            BiInsertFree(range);
+            BiAddHeapUsage(rangeEnd - allocBase);
+            BiHeapPermanent += rangeEnd - allocBase;
         } else {
-            auto newAnchor = BL_LIST_PREV(struct HeapRange, Node, *range);
             BlListRemove(&BlHeapRanges, &range->Node);
-            BlListRemove(&BlFreeRanges, &range->FreeNode);
-            range = newAnchor;
+            BiAddHeapUsage(rangeEnd - rangeBase);
+            BiHeapPermanent += rangeEnd - rangeBase;
         }
 
-        if (!permanent) {
-            auto newRange = (struct HeapRange *)allocBase;
-            newRange->End = allocEnd;
-            newRange->Free = false;
-            BlListInsertAfter(&BlHeapRanges, &range->Node, &newRange->Node);
-        }
-
-        return (void *)valueBase;
+        return (void *)allocBase;
     }
 
-    BlCrash("out of memory");
+    return nullptr;
+}
+
+void *BlTryAllocateHeap(size_t size, size_t alignment, bool permanent) {
+    if (size == 0) return nullptr;
+    if (alignment < HEAP_ALIGNMENT) alignment = HEAP_ALIGNMENT;
+
+    size = BL_ALIGN_UP(size, HEAP_ALIGNMENT);
+
+    return permanent ? BiAllocatePermanent(size, alignment) : BiAllocateTransient(size, alignment);
+}
+
+void *BlAllocateHeap(size_t size, size_t alignment, bool permanent) {
+    void *ptr = BlTryAllocateHeap(size, alignment, permanent);
+    if (!ptr && size != 0) BlCrash("out of memory");
+
+    return ptr;
 }
 
 void *BlResizeHeap(void *ptr, size_t newSize, size_t alignment) {
@@ -123,39 +223,47 @@ void *BlResizeHeap(void *ptr, size_t newSize, size_t alignment) {
 
     struct HeapRange *range = ptr - sizeof(*range);
     size_t oldSize = range->End - (size_t)ptr;
+    auto next = BL_LIST_NEXT(struct HeapRange, Node, *range);
+    bool nextFree = next != nullptr && (uintptr_t)next == range->End && next->Free;
 
     if (oldSize >= newSize) {
         size_t extra = oldSize - newSize;
 
         if (extra >= sizeof(*range)) {
-            struct HeapRange *newRange = ptr + oldSize;
+            struct HeapRange *newRange = ptr + newSize;
             newRange->End = range->End;
-            newRange->Free = true;
+
+            if (nextFree) {
+                BiRemoveFree(next);
+                BlListRemove(&BlHeapRanges, &next->Node);
+                newRange->End = next->End;
+            }
+
             BlListInsertAfter(&BlHeapRanges, &range->Node, &newRange->Node);
-            BlListInsertAfter(&BlFreeRanges, nullptr, &newRange->FreeNode);
+            BiInsertFree(newRange);
             range->End -= extra;
+            BiHeapUsage -= extra;
         }
 
         return ptr;
     }
 
-    auto next = BL_LIST_NEXT(struct HeapRange, Node, *range);
+    uintptr_t newEnd = (uintptr_t)ptr + newSize;
 
-    if (next != nullptr && (uintptr_t)next == range->End && next->Free) {
+    if (nextFree && next->End >= newEnd) {
+        BiRemoveFree(next);
         BlListRemove(&BlHeapRanges, &next->Node);
-        BlListRemove(&BlFreeRanges, &next->FreeNode);
-
-        uintptr_t newEnd = (uintptr_t)ptr + newSize;
 
         if (next->End - newEnd >= sizeof(*range)) {
             auto newRange = (struct HeapRange *)newEnd;
-            BlCopyMemoryOverlapping(newRange, next, sizeof(*newRange));
+            newRange->End = next->End;
             BlListInsertAfter(&BlHeapRanges, &range->Node, &newRange->Node);
-            BlListInsertAfter(&BlFreeRanges, nullptr, &newRange->FreeNode);
+            BiInsertFree(newRange);
         } else {
             newEnd = next->End;
         }
 
+        BiAddHeapUsage(newEnd - range->End);
         range->End = newEnd;
         return ptr;
     }
@@ -170,6 +278,7 @@ void BlFreeHeap(void *ptr) {
     if (!ptr) return;
 
     struct HeapRange *range = ptr - sizeof(*range);
+    BiHeapUsage -= BiRangeSize(range);
 
     auto prev = BL_LIST_PREV(struct HeapRange, Node, *range);
     auto next = BL_LIST_NEXT(struct HeapRange, Node, *range);
@@ -177,24 +286,56 @@ void BlFreeHeap(void *ptr) {
     bool mergePrev = prev != nullptr && prev->Free && prev->End == (uintptr_t)range;
     bool mergeNext = next != nullptr && next->Free && range->End == (uintptr_t)next;
 
+    if (mergeNext) {
+        BiRemoveFree(next);
+        BlListRemove(&BlHeapRanges, &next->Node);
+        range->End = next->End;
+    }
+
     if (mergePrev) {
+        BiRemoveFree(prev);
         BlListRemove(&BlHeapRanges, &range->Node);
-
-        if (mergeNext) {
-            BlListRemove(&BlHeapRanges, &next->Node);
-            BlListRemove(&BlFreeRanges, &next->FreeNode);
-            prev->End = next->End;
-        } else {
-            prev->End = range->End;
-        }
+        prev->End = range->End;
+        BiInsertFree(prev);
     } else {
-        if (mergeNext) {
-            BlListRemove(&BlHeapRanges, &next->Node);
-            BlListRemove(&BlFreeRanges, &next->FreeNode);
-            range->End = next->End;
-        }
+        BiInsertFree(range);
+    }
+}
+
+size_t BlGetFreeHeapSize(void) {
+    return BiHeapFree;
+}
 
-        range->Free = true;
-        BlListInsertAfter(&BlFreeRanges, nullptr, &range->FreeNode);
+size_t BlGetHeapPeakUsage(void) {
+    return BiHeapPeakUsage;
+}
+
+void BlPrintHeapStatistics(void) {
+    size_t freeRanges = 0;
+    size_t largestFree = 0;
+
+    for (size_t i = 0; i < BI_HEAP_BINS; i++) {
+        BL_LIST_FOREACH(BiFreeBins[i], struct HeapRange, FreeNode, range) {
+            freeRanges += 1;
+            largestFree = BL_MAX(largestFree, BiRangeSize(range));
+        }
     }
+
+    // the share of free memory that isn't part of the largest free range
+    size_t fragmentation = BiHeapFree >= 100 ? (BiHeapFree - largestFree) / (BiHeapFree / 100) : 0;
+
+    BlPrint(
+        "Heap: %zu bytes, %zu in use (%zu permanent), %zu peak\n",
+        BiHeapSize,
+        BiHeapUsage,
+        BiHeapPermanent,
+        BiHeapPeakUsage
+    );
+    BlPrint(
+        "Heap free: %zu bytes in %zu ranges, largest %zu (%zu%% fragmented)\n",
+        BiHeapFree,
+        freeRanges,
+        largestFree,
+        fragmentation
+    );
 }
@@ -1,5 +1,6 @@
 #include "paging.h"
 #include "compiler.h"
+#include "dt.h"
 #include "logging.h"
 #include "memory.h"
 
@@ -11,6 +12,7 @@
 #define BI_LEVEL_COUNT 2
 #define BI_LEVEL_SIZE (1U << BI_LEVEL_SHIFT)
 #define BI_LEVEL_MASK (BI_LEVEL_SIZE - 1)
+#define BI_TABLE_SHIFT (BL_PAGE_SHIFT + BI_LEVEL_SHIFT)
 
 typedef uint32_t pte_t;
 
@@ -46,6 +48,8 @@ static inline pte_t *BiGetTable(uintptr_t virt, bool allowCreation) {
             BlFillMemory(newTable, 0, BL_PAGE_SIZE);
             table[index] = BiCreatePte((uintptr_t)newTable);
             table = newTable;
+
+            BlDtReserveBootMemory((uintptr_t)newTable, BL_PAGE_SIZE);
         } else {
             BlCrash("BiGetTable: not found");
         }
@@ -54,8 +58,43 @@ static inline pte_t *BiGetTable(uintptr_t virt, bool allowCreation) {
     return table;
 }
 
+void BlInitPageTables(void) {
+    // the root table is part of the bootloader image, so it isn't reserved by allocating it
+    BlDtReserveBootMemory((uintptr_t)BlPageTable, sizeof(BlPageTable));
+}
+
 void BlMapPage(uintptr_t virt, paddr_t phys) {
     BiGetTable(virt, true)[BiPteIndex(virt, 0)] = BiCreatePte(phys);
+    BlDtReserveBootMemory(phys, BL_PAGE_SIZE);
+}
+
+void BlMapRange(uintptr_t virt, paddr_t phys, size_t size) {
+    size = BL_ALIGN_DOWN(size, BL_PAGE_SIZE);
+
+    while (size != 0) {
+        pte_t *table = BiGetTable(virt, true);
+        size_t index = BiPteIndex(virt, 0);
+        size_t count = BL_MIN(BI_LEVEL_SIZE - index, size >> BL_PAGE_SHIFT);
+
+        for (size_t i = 0; i < count; i++) {
+            table[index + i] = BiCreatePte(phys + (i << BL_PAGE_SHIFT));
+        }
+
+        virt += count << BL_PAGE_SHIFT;
+        phys += count << BL_PAGE_SHIFT;
+        size -= count << BL_PAGE_SHIFT;
+    }
+}
+
+void BlCreatePageTables(uintptr_t virt, size_t size) {
+    if (size == 0) return;
+
+    uintptr_t first = virt >> BI_TABLE_SHIFT;
+    uintptr_t last = (virt + (size - 1)) >> BI_TABLE_SHIFT;
+
+    for (uintptr_t i = first; i <= last; i++) {
+        BiGetTable(i << BI_TABLE_SHIFT, true);
+    }
 }
 
 paddr_t BlGetMapping(uintptr_t virt) {
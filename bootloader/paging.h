@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define BL_PAGE_SHIFT 12
@@ -8,5 +9,15 @@
 
 typedef uint32_t paddr_t;
 
+// reserves the root page table, which is handed over to the kernel whether or not anything is mapped
+void BlInitPageTables(void);
+
 void BlMapPage(uintptr_t virt, paddr_t phys);
+
+// Maps a page-aligned range without reserving the pages it points to, for memory that the kernel manages itself. The
+// page tables are still reserved.
+void BlMapRange(uintptr_t virt, paddr_t phys, size_t size);
+
+// creates the page tables needed to map [virt,virt+size), so that mapping pages there later doesn't allocate
+void BlCreatePageTables(uintptr_t virt, size_t size);
 paddr_t BlGetMapping(uintptr_t virt);
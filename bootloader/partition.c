@@ -4,8 +4,10 @@
 #include "filesystem.h"
 #include "list.h"
 #include "logging.h"
+#include "memory.h"
 #include "platform.h"
 #include "platformdefs.h"
+#include "timing.h"
 
 #define BI_BCACHE_SHIFT 12
 #define BI_BCACHE_SIZE (1u << BI_BCACHE_SHIFT)
@@ -13,74 +15,212 @@
 
 _Static_assert(BI_BCACHE_SHIFT >= BL_SECTOR_SHIFT, "BI_BCACHE_SHIFT must be larger than BL_SECTOR_SHIFT");
 
-#define BL_BCACHE_COUNT 16
+// the cache uses 1/2^BI_BCACHE_HEAP_SHIFT of the free heap, clamped to [BI_BCACHE_MIN_COUNT, BI_BCACHE_MAX_COUNT]
+#define BI_BCACHE_HEAP_SHIFT 5
+#define BI_BCACHE_MIN_COUNT 16
+#define BI_BCACHE_MAX_COUNT 1024
+
+// The cache uses the simplified 2Q replacement policy: blocks are first placed in a FIFO queue (In), and only promoted
+// to the LRU queue (Main) if they are requested again after having been evicted from In, which is tracked using a
+// queue of data-less ghost entries (Out). This keeps bulk reads from flushing frequently-used metadata from the cache.
+enum BiBCacheQueue {
+    BI_BCACHE_IN,
+    BI_BCACHE_MAIN,
+    BI_BCACHE_OUT,
+};
 
 struct BiBCacheMeta {
     struct BlListNode Node;
+    struct BiBCacheMeta *HashNext;
     uint64_t Block;
     void *Data;
+    enum BiBCacheQueue Queue;
 };
 
-_Alignas(BL_BCACHE_ALIGN) static unsigned char BiBCacheData[BL_BCACHE_COUNT][BI_BCACHE_SIZE];
-static struct BiBCacheMeta BiBCacheMeta[BL_BCACHE_COUNT];
+static struct BiBCacheMeta *BiBCacheMeta;
+static struct BiBCacheMeta **BiBCacheHash;
+static size_t BiBCacheHashMask;
+static size_t BiBCacheCount;
 static size_t BiBCacheUsed;
 
-static struct BlList BiBCache;
+static struct BlList BiBCacheIn;
+static struct BlList BiBCacheMain;
+static struct BlList BiBCacheOut;
+static struct BlList BiBCacheFreeGhosts;
+static size_t BiBCacheInCount;
+static size_t BiBCacheInMax;
 
-static void *BiGetBCacheEntry(uint64_t block) {
-    BL_LIST_FOREACH(BiBCache, struct BiBCacheMeta, Node, entry) {
-        if (entry->Block == block) {
-            BlListRemove(&BiBCache, &entry->Node);
-            BlListInsertAfter(&BiBCache, nullptr, &entry->Node);
-            return entry->Data;
-        }
+static size_t BiDiskReads;
+static size_t BiDiskSectors;
+static size_t BiBCacheHits;
+static size_t BiBCacheMisses;
+static size_t BiBCacheEvictions;
+
+static void BiReadSectors(void *buffer, uint64_t sector, size_t count) {
+    BiDiskReads += 1;
+    BiDiskSectors += count;
+
+    if (!BxReadFromDisk(buffer, sector, count)) BlCrash("failed to read from disk");
+}
+
+static void BiInitializeBCache(void) {
+    size_t count = (BlGetFreeHeapSize() >> BI_BCACHE_HEAP_SHIFT) >> BI_BCACHE_SHIFT;
+    count = BL_MAX(BL_MIN(count, (size_t)BI_BCACHE_MAX_COUNT), (size_t)BI_BCACHE_MIN_COUNT);
+
+    size_t ghosts = count / 2;
+    size_t buckets = 1;
+    while (buckets < count + ghosts) buckets <<= 1;
+
+    void *data = BlAllocateHeap(count << BI_BCACHE_SHIFT, BL_BCACHE_ALIGN, true);
+
+    BiBCacheMeta = BL_ALLOCATE(struct BiBCacheMeta, count + ghosts);
+    BiBCacheHash = BL_ALLOCATE(struct BiBCacheMeta *, buckets);
+    BlFillMemory(BiBCacheHash, 0, buckets * sizeof(*BiBCacheHash));
+
+    for (size_t i = 0; i < count; i++) {
+        BiBCacheMeta[i].Data = data + (i << BI_BCACHE_SHIFT);
     }
 
-    struct BiBCacheMeta *entry;
+    for (size_t i = count; i < count + ghosts; i++) {
+        BiBCacheMeta[i].Data = nullptr;
+        BlListInsertBefore(&BiBCacheFreeGhosts, nullptr, &BiBCacheMeta[i].Node);
+    }
+
+    BiBCacheHashMask = buckets - 1;
+    BiBCacheCount = count;
+    BiBCacheInMax = BL_MAX(count / 4, (size_t)1);
+}
+
+static struct BiBCacheMeta **BiBCacheBucket(uint64_t block) {
+    uint32_t hash = ((uint32_t)block ^ (uint32_t)(block >> 32)) * 0x9e3779b1;
+    return &BiBCacheHash[(hash >> 16) & BiBCacheHashMask];
+}
+
+static void BiBCacheHashInsert(struct BiBCacheMeta *entry) {
+    struct BiBCacheMeta **bucket = BiBCacheBucket(entry->Block);
+    entry->HashNext = *bucket;
+    *bucket = entry;
+}
+
+static void BiBCacheHashRemove(struct BiBCacheMeta *entry) {
+    struct BiBCacheMeta **link = BiBCacheBucket(entry->Block);
+    while (*link != entry) link = &(*link)->HashNext;
+    *link = entry->HashNext;
+}
+
+static struct BiBCacheMeta *BiBCacheHashFind(uint64_t block) {
+    for (struct BiBCacheMeta *entry = *BiBCacheBucket(block); entry != nullptr; entry = entry->HashNext) {
+        if (entry->Block == block) return entry;
+    }
+
+    return nullptr;
+}
+
+// remembers a block that was evicted from In, so that it can be promoted to Main if it is requested again
+static void BiBCacheAddGhost(uint64_t block) {
+    struct BiBCacheMeta *ghost = BL_LIST_HEAD(struct BiBCacheMeta, Node, BiBCacheFreeGhosts);
 
-    if (BiBCacheUsed < BL_BCACHE_COUNT) {
-        entry = &BiBCacheMeta[BiBCacheUsed];
-        entry->Data = &BiBCacheData[BiBCacheUsed];
-        BiBCacheUsed += 1;
+    if (ghost) {
+        BlListRemove(&BiBCacheFreeGhosts, &ghost->Node);
     } else {
-        entry = BL_CONTAINER(struct BiBCacheMeta, Node, BiBCache.Tail);
-        BlListRemove(&BiBCache, &entry->Node);
+        ghost = BL_LIST_TAIL(struct BiBCacheMeta, Node, BiBCacheOut);
+        if (!ghost) return;
+
+        BlListRemove(&BiBCacheOut, &ghost->Node);
+        BiBCacheHashRemove(ghost);
     }
 
-    if (!BxReadFromDisk(
-            entry->Data,
-            block << (BI_BCACHE_SHIFT - BL_SECTOR_SHIFT),
-            1ull << (BI_BCACHE_SHIFT - BL_SECTOR_SHIFT)
-        )) {
-        BlCrash("failed to read from disk");
+    ghost->Block = block;
+    ghost->Queue = BI_BCACHE_OUT;
+    BiBCacheHashInsert(ghost);
+    BlListInsertAfter(&BiBCacheOut, nullptr, &ghost->Node);
+}
+
+static struct BiBCacheMeta *BiBCacheReclaim(void) {
+    if (BiBCacheUsed < BiBCacheCount) return &BiBCacheMeta[BiBCacheUsed++];
+
+    struct BiBCacheMeta *entry;
+    BiBCacheEvictions += 1;
+
+    if (BiBCacheInCount > BiBCacheInMax || BiBCacheMain.Tail == nullptr) {
+        entry = BL_LIST_TAIL(struct BiBCacheMeta, Node, BiBCacheIn);
+        BlListRemove(&BiBCacheIn, &entry->Node);
+        BiBCacheHashRemove(entry);
+        BiBCacheInCount -= 1;
+        BiBCacheAddGhost(entry->Block);
+    } else {
+        entry = BL_LIST_TAIL(struct BiBCacheMeta, Node, BiBCacheMain);
+        BlListRemove(&BiBCacheMain, &entry->Node);
+        BiBCacheHashRemove(entry);
+    }
+
+    return entry;
+}
+
+static void *BiGetBCacheEntry(uint64_t block) {
+    if (BiBCacheCount == 0) BiInitializeBCache();
+
+    struct BiBCacheMeta *entry = BiBCacheHashFind(block);
+    bool promote = false;
+
+    if (entry) {
+        switch (entry->Queue) {
+        case BI_BCACHE_IN: BiBCacheHits += 1; return entry->Data;
+        case BI_BCACHE_MAIN:
+            BiBCacheHits += 1;
+            BlListRemove(&BiBCacheMain, &entry->Node);
+            BlListInsertAfter(&BiBCacheMain, nullptr, &entry->Node);
+            return entry->Data;
+        case BI_BCACHE_OUT:
+            BlListRemove(&BiBCacheOut, &entry->Node);
+            BiBCacheHashRemove(entry);
+            BlListInsertAfter(&BiBCacheFreeGhosts, nullptr, &entry->Node);
+            promote = true;
+            break;
+        }
     }
 
+    BiBCacheMisses += 1;
+    entry = BiBCacheReclaim();
+
+    BiReadSectors(entry->Data, block << (BI_BCACHE_SHIFT - BL_SECTOR_SHIFT), 1u << (BI_BCACHE_SHIFT - BL_SECTOR_SHIFT));
+
     entry->Block = block;
-    BlListInsertAfter(&BiBCache, nullptr, &entry->Node);
+    BiBCacheHashInsert(entry);
+
+    if (promote) {
+        entry->Queue = BI_BCACHE_MAIN;
+        BlListInsertAfter(&BiBCacheMain, nullptr, &entry->Node);
+    } else {
+        entry->Queue = BI_BCACHE_IN;
+        BlListInsertAfter(&BiBCacheIn, nullptr, &entry->Node);
+        BiBCacheInCount += 1;
+    }
 
     return entry->Data;
 }
 
 static void BiReadFromDisk(void *buffer, uint64_t position, size_t count, bool bypassCache) {
-    if (bypassCache) {
-        if (position & BL_SECTOR_MASK) BlCrash("BiReadFromDisk: unaligned position");
-        if (count & BL_SECTOR_MASK) BlCrash("BiReadFromDisk: unaligned size");
+    // only whole sectors can be transferred directly, anything else goes through the cache
+    if (bypassCache && (position & BL_SECTOR_MASK) == 0 && ((uintptr_t)buffer & BL_SECTOR_MASK) == 0) {
+        size_t aligned = count & ~BL_SECTOR_MASK;
+        if (aligned != 0) BiReadSectors(buffer, position >> BL_SECTOR_SHIFT, aligned >> BL_SECTOR_SHIFT);
+
+        buffer += aligned;
+        position += aligned;
+        count -= aligned;
+    }
 
-        if (!BxReadFromDisk(buffer, position >> BL_SECTOR_SHIFT, count >> BL_SECTOR_SHIFT)) {
-            BlCrash("failed to read from disk");
-        }
-    } else {
-        while (count != 0) {
-            uint64_t block = position >> BI_BCACHE_SHIFT;
-            size_t offset = position & BI_BCACHE_MASK;
-            size_t current = BL_MIN(BI_BCACHE_SIZE - offset, count);
+    while (count != 0) {
+        uint64_t block = position >> BI_BCACHE_SHIFT;
+        size_t offset = position & BI_BCACHE_MASK;
+        size_t current = BL_MIN(BI_BCACHE_SIZE - offset, count);
 
-            BlCopyMemory(buffer, BiGetBCacheEntry(block) + offset, current);
+        BlCopyMemory(buffer, BiGetBCacheEntry(block) + offset, current);
 
-            buffer += current;
-            position += current;
-            count -= current;
-        }
+        buffer += current;
+        position += current;
+        count -= current;
     }
 }
 
@@ -134,8 +274,11 @@ void BlFindRootPartition(void) {
 
         auto file = BlFsFind("xrlinux.cfg");
         if (!file) continue;
+        BlBeginPhase(BL_PHASE_CONFIG);
         BlLoadConfigurationFromFile(file);
         BlFsFree(file);
+        BlFsLoadPathCache();
+        BlEndPhase(BL_PHASE_CONFIG);
         return;
     }
 
@@ -149,6 +292,21 @@ void BlReadFromPartition(void *buffer, uint64_t position, size_t count, bool byp
     BiReadFromDisk(buffer, BlRootPartition.Start + position, count, bypassCache);
 }
 
+uint64_t BlRootPartitionStart(void) {
+    return BlRootPartition.Start;
+}
+
 uint64_t BlRootPartitionSize(void) {
     return BlRootPartition.Size;
 }
+
+void BlPrintDiskStatistics(void) {
+    BlPrint("Disk: %zu reads, %zu sectors\n", BiDiskReads, BiDiskSectors);
+    BlPrint(
+        "Block cache: %zu entries, %zu hits, %zu misses, %zu evictions\n",
+        BiBCacheCount,
+        BiBCacheHits,
+        BiBCacheMisses,
+        BiBCacheEvictions
+    );
+}
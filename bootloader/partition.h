@@ -9,4 +9,7 @@ void BlFindRootPartition(void);
 
 void BlReadFromPartition(void *buffer, uint64_t position, size_t count, bool bypassCache);
 
+uint64_t BlRootPartitionStart(void);
 uint64_t BlRootPartitionSize(void);
+
+void BlPrintDiskStatistics(void);
@@ -3,9 +3,20 @@
 extern size_t BxNumCpus;
 
 _Noreturn void BxReturnToFirmware(void);
-void BxPrintCharacter(unsigned char c);
+void BxPrintString(const char *str);
+
+// milliseconds since the unix epoch
+uint64_t BxGetTimeMs(void);
+
+// calls func for every range of RAM in ascending order, with adjacent banks merged
+void BxForEachMemoryRange(void (*func)(uintptr_t base, size_t size, void *ctx), void *ctx);
+
+// index of the boot disk among the disks of the platform's disk controller
+uint32_t BxBootDiskIndex(void);
 
 // read [sector,Min(sector+count,NumberOfSectors)) from the boot disk into buffer
 bool BxReadFromDisk(void *buffer, uint64_t sector, size_t count);
 
+// Starts func on every other processor, and returns once all of them have picked it up. Can only be called once, and
+// func must not return. Use BlRunOnOtherCpus instead.
 void BxRunOnOtherCpus(void (*func)(void *), void *ctx);
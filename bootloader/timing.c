@@ -0,0 +1,74 @@
+#include "timing.h"
+#include "compiler.h"
+#include "dt.h"
+#include "logging.h"
+#include "platform.h"
+
+struct BiPhaseTiming {
+    uint32_t Start;
+    uint32_t End;
+};
+
+static const char *BiPhaseNames[BL_PHASE_COUNT] = {
+    [BL_PHASE_ROOT_PARTITION] = "root-partition",
+    [BL_PHASE_CONFIG] = "config",
+    [BL_PHASE_INITRD] = "initrd",
+    [BL_PHASE_KERNEL] = "kernel",
+    [BL_PHASE_DEVICE_TREE] = "device-tree",
+};
+
+static uint64_t BiBootEpoch;
+static struct BiPhaseTiming BiPhases[BL_PHASE_COUNT];
+static struct BlDtNode *BiTimingsNode;
+
+// all timestamps are in milliseconds relative to BiBootEpoch
+static uint32_t BiCurrentTime(void) {
+    return BxGetTimeMs() - BiBootEpoch;
+}
+
+void BlStartTiming(void) {
+    BiBootEpoch = BxGetTimeMs();
+}
+
+void BlBeginPhase(enum BlBootPhase phase) {
+    BiPhases[phase].Start = BiCurrentTime();
+}
+
+void BlEndPhase(enum BlBootPhase phase) {
+    BiPhases[phase].End = BiCurrentTime();
+}
+
+static void BiGetTimingCells(uint32_t *cells) {
+    for (size_t i = 0; i < BL_PHASE_COUNT; i++) {
+        cells[i * 2] = BiPhases[i].Start;
+        cells[i * 2 + 1] = BiPhases[i].End;
+    }
+}
+
+void BlDtAddBootTimings(void) {
+    uint32_t epoch[] = {BiBootEpoch >> 32, BiBootEpoch};
+    uint32_t cells[BL_PHASE_COUNT * 2];
+    BiGetTimingCells(cells);
+
+    // phases that haven't ended yet are filled in by BlDtUpdateBootTimings
+    BiTimingsNode = BlDtFindOrCreateNode(nullptr, "chosen");
+    BlDtAddPropertyU32s(BiTimingsNode, "xrlinux,boot-epoch-ms", epoch, BL_ARRAY_SIZE(epoch));
+    BlDtAddPropertyStrings(BiTimingsNode, "xrlinux,boot-timing-names", BiPhaseNames, BL_PHASE_COUNT);
+    BlDtAddPropertyU32s(BiTimingsNode, "xrlinux,boot-timings", cells, BL_ARRAY_SIZE(cells));
+}
+
+void BlDtUpdateBootTimings(void) {
+    uint32_t *data = BlDtGetBlobProperty(BiTimingsNode, "xrlinux,boot-timings");
+    uint32_t cells[BL_PHASE_COUNT * 2];
+    BiGetTimingCells(cells);
+
+    for (size_t i = 0; i < BL_ARRAY_SIZE(cells); i++) {
+        data[i] = BL_BE32(cells[i]);
+    }
+}
+
+void BlPrintBootTimings(void) {
+    for (size_t i = 0; i < BL_PHASE_COUNT; i++) {
+        BlPrint("Phase %s: %u ms\n", BiPhaseNames[i], BiPhases[i].End - BiPhases[i].Start);
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+enum BlBootPhase {
+    BL_PHASE_ROOT_PARTITION,
+    BL_PHASE_CONFIG,
+    BL_PHASE_INITRD,
+    BL_PHASE_KERNEL,
+    BL_PHASE_DEVICE_TREE,
+    BL_PHASE_COUNT,
+};
+
+void BlStartTiming(void);
+void BlBeginPhase(enum BlBootPhase phase);
+void BlEndPhase(enum BlBootPhase phase);
+
+// Adds the boot timing properties to /chosen. Must be called before the device tree blob is built.
+void BlDtAddBootTimings(void);
+
+// Updates the boot timing properties in an already built device tree blob.
+void BlDtUpdateBootTimings(void);
+
+void BlPrintBootTimings(void);
@@ -0,0 +1,121 @@
+#include "workqueue.h"
+#include "asm.h"
+#include "compiler.h"
+#include "platform.h"
+
+// fills smaller than this aren't worth waking up the other processors for
+#define BI_PARALLEL_FILL_MIN 0x4'0000
+#define BI_PARALLEL_FILL_SHIFT 16
+#define BI_PARALLEL_FILL_CHUNK (1u << BI_PARALLEL_FILL_SHIFT)
+
+// The firmware gives no guarantee that a processor whose kicked function returns can be kicked again, so the other
+// processors are only kicked once, into BiWaitForWork, and get everything after that through BiOtherCpusWork.
+static struct {
+    void (*Func)(void *);
+    void *Ctx;
+    size_t Generation;
+    size_t NumStarted;
+} BiOtherCpusWork;
+
+static bool BiOtherCpusWaiting;
+
+static void BiWaitForWork(void *) {
+    size_t seen = 0;
+
+    while (true) {
+        size_t generation;
+
+        while ((generation = __atomic_load_n(&BiOtherCpusWork.Generation, __ATOMIC_ACQUIRE)) == seen) {
+            BlSpinPause();
+        }
+
+        seen = generation;
+
+        void (*func)(void *) = BiOtherCpusWork.Func;
+        void *ctx = BiOtherCpusWork.Ctx;
+
+        BlAtomicFetchAdd(&BiOtherCpusWork.NumStarted, 1);
+
+        func(ctx);
+    }
+}
+
+void BlRunOnOtherCpus(void (*func)(void *), void *ctx) {
+    if (BxNumCpus == 1) return;
+
+    if (!BiOtherCpusWaiting) {
+        BxRunOnOtherCpus(BiWaitForWork, nullptr);
+        BiOtherCpusWaiting = true;
+    }
+
+    // every processor picked up the previous function before that call returned, so nobody reads these anymore
+    BiOtherCpusWork.Func = func;
+    BiOtherCpusWork.Ctx = ctx;
+    BiOtherCpusWork.NumStarted = 0;
+    BlAtomicFetchAdd(&BiOtherCpusWork.Generation, 1);
+
+    while (__atomic_load_n(&BiOtherCpusWork.NumStarted, __ATOMIC_ACQUIRE) < BxNumCpus - 1) {
+        BlSpinPause();
+    }
+}
+
+struct BiWorkQueue {
+    void (*Func)(void *, size_t);
+    void *Ctx;
+    size_t Count;
+    size_t NextIndex;
+    size_t NumExited;
+};
+
+static void BiRunWorkQueue(void *ptr) {
+    struct BiWorkQueue *queue = ptr;
+
+    while (true) {
+        size_t index = BlAtomicFetchAdd(&queue->NextIndex, 1);
+        if (index >= queue->Count) break;
+
+        queue->Func(queue->Ctx, index);
+    }
+
+    // the queue lives on the boot processor's stack, so this has to be the last access to it
+    BlAtomicFetchAdd(&queue->NumExited, 1);
+}
+
+void BlRunWorkQueue(void (*func)(void *, size_t), void *ctx, size_t count) {
+    struct BiWorkQueue queue = {func, ctx, count, 0, 0};
+    size_t participants = 1;
+
+    if (count > 1 && BxNumCpus > 1) {
+        BlRunOnOtherCpus(BiRunWorkQueue, &queue);
+        participants = BxNumCpus;
+    }
+
+    BiRunWorkQueue(&queue);
+
+    while (__atomic_load_n(&queue.NumExited, __ATOMIC_ACQUIRE) < participants) {
+        BlSpinPause();
+    }
+}
+
+struct BiFillWork {
+    unsigned char *Dest;
+    size_t Count;
+    unsigned char Value;
+};
+
+static void BiFillChunk(void *ptr, size_t index) {
+    struct BiFillWork *work = ptr;
+    size_t offset = index << BI_PARALLEL_FILL_SHIFT;
+
+    BlFillMemory(work->Dest + offset, work->Value, BL_MIN(work->Count - offset, (size_t)BI_PARALLEL_FILL_CHUNK));
+}
+
+void BlFillMemoryParallel(void *dest, unsigned char value, size_t count) {
+    if (count < BI_PARALLEL_FILL_MIN || BxNumCpus == 1) {
+        BlFillMemory(dest, value, count);
+        return;
+    }
+
+    struct BiFillWork work = {dest, count, value};
+    BlRunWorkQueue(BiFillChunk, &work, BL_ALIGN_UP(count, (size_t)BI_PARALLEL_FILL_CHUNK) >> BI_PARALLEL_FILL_SHIFT);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+
+// Starts func(ctx) on every other processor, and returns once all of them have picked it up. Unlike
+// BxRunOnOtherCpus, this can be called more than once: once func returns, the processor waits for the next call.
+void BlRunOnOtherCpus(void (*func)(void *), void *ctx);
+
+// Calls func(ctx, index) for every index in [0,count), spreading the calls over all processors. The calls can run in
+// any order and at the same time, so func must not print, allocate, or touch any other shared bootloader state.
+// Returns once all calls have finished.
+void BlRunWorkQueue(void (*func)(void *ctx, size_t index), void *ctx, size_t count);
+
+// BlFillMemory, but large buffers are split between all processors
+void BlFillMemoryParallel(void *dest, unsigned char value, size_t count);
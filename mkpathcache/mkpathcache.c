@@ -0,0 +1,414 @@
+// Writes the path cache that lets the bootloader open KernelPath and InitrdPath without looking them up. Run it on the
+// mounted boot filesystem whenever the kernel or initrd are replaced; a stale cache is harmless, but no longer helps.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#define CACHE_NAME "xrlinux.cache"
+#define CONFIG_NAME "xrlinux.cfg"
+#define CACHE_MAGIC 0x43505258
+#define CACHE_VERSION 2
+#define MAX_SYMLINKS 5
+#define FIEMAP_BATCH 64
+
+// extents that the bootloader can't read straight from the disk
+#define FIEMAP_UNSUPPORTED                                                                                             \
+    (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_ENCRYPTED |          \
+     FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL)
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LE32(x) (x)
+#define LE64(x) (x)
+#elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LE32(x) __builtin_bswap32(x)
+#define LE64(x) __builtin_bswap64(x)
+#else
+#error "Unsupported byte order"
+#endif
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(*(x)))
+
+// these must match the structures in bootloader/filesystem.c
+struct CacheHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EntryCount;
+    uint32_t Reserved;
+} __attribute__((packed, aligned(4)));
+
+struct CacheEntry {
+    uint32_t PathLength;
+    uint32_t InodeCount;
+    uint32_t ExtentCount;
+    uint32_t Reserved;
+} __attribute__((packed, aligned(4)));
+
+// the generation of symlinks can't be queried, as they can't be opened
+#define CACHE_INODE_GENERATION (1u << 0)
+
+struct CacheInode {
+    uint32_t Inode;
+    uint32_t Flags;
+    uint32_t Generation;
+    uint32_t Reserved;
+    uint32_t Mtime;
+    uint32_t MtimeNsec;
+    uint32_t Ctime;
+    uint32_t CtimeNsec;
+    uint64_t Size;
+} __attribute__((packed, aligned(4)));
+
+struct CacheExtent {
+    uint64_t Block;
+    uint64_t Count;
+    uint64_t Start;
+} __attribute__((packed, aligned(4)));
+
+struct Path {
+    char *Path;
+    struct CacheInode *Inodes;
+    size_t InodeCount;
+    struct CacheExtent *Extents;
+    size_t ExtentCount;
+};
+
+static const char *AppName;
+static int RootFd;
+static struct stat RootStat;
+static unsigned BlockShift;
+
+_Noreturn static void PerrorDie(const char *message, const char *path) {
+    fprintf(stderr, "%s: %s: %s: %s\n", AppName, path, message, strerror(errno));
+    exit(1);
+}
+
+_Noreturn static void ErrorDie(const char *message, const char *path) {
+    fprintf(stderr, "%s: %s: %s\n", AppName, path, message);
+    exit(1);
+}
+
+static void *Resize(void *ptr, size_t size) {
+    ptr = realloc(ptr, size);
+    if (!ptr) PerrorDie("out of memory", CACHE_NAME);
+    return ptr;
+}
+
+// Timestamps only change once per second on filesystems without nanosecond timestamps, and inode numbers get reused,
+// so the generation is recorded as well if `fd` refers to the inode.
+static void AddInode(struct Path *path, const struct stat *st, int fd) {
+    if (st->st_dev != RootStat.st_dev) ErrorDie("lookup leaves the boot filesystem", path->Path);
+
+    for (size_t i = 0; i < path->InodeCount; i++) {
+        if (LE32(path->Inodes[i].Inode) == st->st_ino) return;
+    }
+
+    uint32_t flags = 0;
+    int generation = 0;
+
+    if (fd >= 0) {
+        if (ioctl(fd, FS_IOC_GETVERSION, &generation)) PerrorDie("failed to get inode generation", path->Path);
+        flags |= CACHE_INODE_GENERATION;
+    }
+
+    path->Inodes = Resize(path->Inodes, (path->InodeCount + 1) * sizeof(*path->Inodes));
+    path->Inodes[path->InodeCount++] = (struct CacheInode){
+        .Inode = LE32((uint32_t)st->st_ino),
+        .Flags = LE32(flags),
+        .Generation = LE32((uint32_t)generation),
+        .Mtime = LE32((uint32_t)st->st_mtim.tv_sec),
+        .MtimeNsec = LE32((uint32_t)st->st_mtim.tv_nsec),
+        .Ctime = LE32((uint32_t)st->st_ctim.tv_sec),
+        .CtimeNsec = LE32((uint32_t)st->st_ctim.tv_nsec),
+        .Size = LE64((uint64_t)st->st_size),
+    };
+}
+
+// Looks up `name` the same way the bootloader does: relative to `dir`, or to the root of the boot filesystem if it is
+// absolute. Every inode the lookup reads is recorded, and the final file ends up last.
+static int Lookup(struct Path *path, int dir, const char *name, int symlinks) {
+    if (symlinks == MAX_SYMLINKS) ErrorDie("too many levels of symbolic links", path->Path);
+    if (name[0] == 0) ErrorDie("empty path", path->Path);
+
+    dir = dup(name[0] == '/' ? RootFd : dir);
+    if (dir < 0) PerrorDie("dup failed", path->Path);
+
+    while (true) {
+        struct stat st;
+        if (fstat(dir, &st)) PerrorDie("stat failed", path->Path);
+        if (name[0] != 0 && !S_ISDIR(st.st_mode)) ErrorDie("not a directory", path->Path);
+
+        while (name[0] == '/') name++;
+        if (name[0] == 0) break;
+
+        AddInode(path, &st, dir);
+
+        size_t length = strcspn(name, "/");
+        char *component = strndup(name, length);
+        name += length;
+
+        // the root directory is its own parent on disk, even if it's mounted somewhere else
+        int child;
+
+        if (strcmp(component, "..") == 0 && st.st_dev == RootStat.st_dev && st.st_ino == RootStat.st_ino) {
+            child = dup(RootFd);
+        } else {
+            child = openat(dir, component, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+        }
+
+        if (child < 0 && errno == ELOOP) {
+            if (fstatat(dir, component, &st, AT_SYMLINK_NOFOLLOW)) PerrorDie("stat failed", path->Path);
+            AddInode(path, &st, -1);
+
+            char *target = Resize(NULL, st.st_size + 1);
+            ssize_t targetLength = readlinkat(dir, component, target, st.st_size + 1);
+            if (targetLength < 0) PerrorDie("readlink failed", path->Path);
+            if (targetLength > st.st_size) ErrorDie("symbolic link changed during lookup", path->Path);
+            target[targetLength] = 0;
+
+            child = Lookup(path, dir, target, symlinks + 1);
+            free(target);
+        } else if (child < 0) {
+            PerrorDie("lookup failed", path->Path);
+        }
+
+        free(component);
+        close(dir);
+        dir = child;
+    }
+
+    return dir;
+}
+
+static void AddExtent(struct Path *path, uint64_t block, uint64_t count, uint64_t start) {
+    if (path->ExtentCount != 0) {
+        struct CacheExtent *last = &path->Extents[path->ExtentCount - 1];
+
+        if (LE64(last->Block) + LE64(last->Count) == block && LE64(last->Start) + LE64(last->Count) == start) {
+            last->Count = LE64(LE64(last->Count) + count);
+            return;
+        }
+    }
+
+    path->Extents = Resize(path->Extents, (path->ExtentCount + 1) * sizeof(*path->Extents));
+    path->Extents[path->ExtentCount++] = (struct CacheExtent){
+        .Block = LE64(block),
+        .Count = LE64(count),
+        .Start = LE64(start),
+    };
+}
+
+static void MapExtents(struct Path *path, int fd) {
+    struct fiemap *map = Resize(NULL, sizeof(*map) + FIEMAP_BATCH * sizeof(struct fiemap_extent));
+    uint64_t blockMask = (1ull << BlockShift) - 1;
+    uint64_t position = 0;
+    bool last = false;
+
+    while (!last) {
+        memset(map, 0, sizeof(*map));
+        map->fm_start = position;
+        map->fm_length = FIEMAP_MAX_OFFSET - position;
+        map->fm_flags = FIEMAP_FLAG_SYNC;
+        map->fm_extent_count = FIEMAP_BATCH;
+
+        if (ioctl(fd, FS_IOC_FIEMAP, map)) PerrorDie("failed to get extents", path->Path);
+        if (map->fm_mapped_extents == 0) break;
+
+        for (size_t i = 0; i < map->fm_mapped_extents; i++) {
+            struct fiemap_extent *extent = &map->fm_extents[i];
+
+            if (extent->fe_flags & FIEMAP_UNSUPPORTED) ErrorDie("file data is not stored in plain blocks", path->Path);
+            if ((extent->fe_logical | extent->fe_physical) & blockMask) ErrorDie("misaligned extent", path->Path);
+
+            // unwritten extents read as zeroes, just like holes, which the bootloader assumes for unlisted blocks
+            if ((extent->fe_flags & FIEMAP_EXTENT_UNWRITTEN) == 0) {
+                AddExtent(
+                    path,
+                    extent->fe_logical >> BlockShift,
+                    (extent->fe_length + blockMask) >> BlockShift,
+                    extent->fe_physical >> BlockShift
+                );
+            }
+
+            position = extent->fe_logical + extent->fe_length;
+            if (extent->fe_flags & FIEMAP_EXTENT_LAST) last = true;
+        }
+    }
+
+    free(map);
+}
+
+static void AddPath(struct Path *path) {
+    int fd = Lookup(path, RootFd, path->Path, 0);
+
+    struct stat st;
+    if (fstat(fd, &st)) PerrorDie("stat failed", path->Path);
+    if (!S_ISREG(st.st_mode)) ErrorDie("not a regular file", path->Path);
+
+    AddInode(path, &st, fd);
+    MapExtents(path, fd);
+    close(fd);
+
+    printf("%s: %zu inodes, %zu extents\n", path->Path, path->InodeCount, path->ExtentCount);
+}
+
+static bool IsWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Finds the paths in the configuration the same way the bootloader parses it: the last occurrence of an option wins.
+static size_t ReadConfiguration(struct Path *paths) {
+    static const char *const options[] = {"KernelPath", "InitrdPath"};
+
+    int fd = openat(RootFd, CONFIG_NAME, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) PerrorDie("failed to open", CONFIG_NAME);
+
+    size_t size = 0;
+    char *data = NULL;
+
+    while (true) {
+        data = Resize(data, size + 4096);
+        ssize_t current = read(fd, data + size, 4096);
+        if (current < 0) PerrorDie("read failed", CONFIG_NAME);
+        if (current == 0) break;
+        size += current;
+    }
+
+    close(fd);
+
+    char *values[ARRAY_SIZE(options)] = {};
+    char *line = data;
+
+    while (line < data + size) {
+        char *lineEnd = memchr(line, '\n', data + size - line);
+        if (!lineEnd) lineEnd = data + size;
+
+        while (line < lineEnd && IsWhitespace(*line)) line++;
+
+        char *valueEnd = memchr(line, '#', lineEnd - line);
+        if (!valueEnd) valueEnd = lineEnd;
+
+        char *nameEnd = memchr(line, ':', valueEnd - line);
+
+        if (nameEnd) {
+            char *value = nameEnd + 1;
+            while (value < valueEnd && IsWhitespace(*value)) value++;
+            while (value < valueEnd && IsWhitespace(valueEnd[-1])) valueEnd--;
+
+            for (size_t i = 0; i < ARRAY_SIZE(options); i++) {
+                if (strlen(options[i]) == (size_t)(nameEnd - line) && !memcmp(options[i], line, nameEnd - line)) {
+                    free(values[i]);
+                    values[i] = strndup(value, valueEnd - value);
+                }
+            }
+        }
+
+        line = lineEnd + 1;
+    }
+
+    free(data);
+
+    size_t count = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(options); i++) {
+        // $BootVolume is the raw partition, so there's nothing to look up
+        if (!values[i] || strcmp(values[i], "$BootVolume") == 0) {
+            free(values[i]);
+            continue;
+        }
+
+        paths[count++] = (struct Path){.Path = values[i]};
+    }
+
+    return count;
+}
+
+static void WriteFully(int fd, const void *buffer, size_t size, off_t offset) {
+    while (size != 0) {
+        ssize_t current = pwrite(fd, buffer, size, offset);
+        if (current < 0) PerrorDie("write failed", CACHE_NAME);
+
+        buffer += current;
+        size -= current;
+        offset += current;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    AppName = argv[0];
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s ROOT\n", AppName);
+        return 2;
+    }
+
+    RootFd = open(argv[1], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (RootFd < 0) PerrorDie("failed to open", argv[1]);
+    if (fstat(RootFd, &RootStat)) PerrorDie("stat failed", argv[1]);
+
+    struct statvfs fs;
+    if (fstatvfs(RootFd, &fs)) PerrorDie("statvfs failed", argv[1]);
+    if (fs.f_bsize == 0 || (fs.f_bsize & (fs.f_bsize - 1))) ErrorDie("unsupported block size", argv[1]);
+    BlockShift = __builtin_ctzl(fs.f_bsize);
+
+    // Create the cache before looking anything up, since adding it to the root directory changes that directory.
+    // Rewriting its contents later doesn't.
+    int cache = openat(RootFd, CACHE_NAME, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (cache < 0) PerrorDie("failed to open", CACHE_NAME);
+
+    struct Path paths[2];
+    size_t count = ReadConfiguration(paths);
+
+    for (size_t i = 0; i < count; i++) {
+        AddPath(&paths[i]);
+    }
+
+    struct CacheHeader header = {
+        .Magic = LE32(CACHE_MAGIC),
+        .Version = LE32(CACHE_VERSION),
+        .EntryCount = LE32(count),
+    };
+
+    off_t offset = 0;
+    WriteFully(cache, &header, sizeof(header), offset);
+    offset += sizeof(header);
+
+    for (size_t i = 0; i < count; i++) {
+        struct Path *path = &paths[i];
+        size_t pathLength = strlen(path->Path);
+        static const char padding[4];
+
+        struct CacheEntry entry = {
+            .PathLength = LE32(pathLength),
+            .InodeCount = LE32(path->InodeCount),
+            .ExtentCount = LE32(path->ExtentCount),
+        };
+
+        WriteFully(cache, &entry, sizeof(entry), offset);
+        offset += sizeof(entry);
+        WriteFully(cache, path->Path, pathLength, offset);
+        offset += pathLength;
+        WriteFully(cache, padding, -pathLength & 3, offset);
+        offset += -pathLength & 3;
+        WriteFully(cache, path->Inodes, path->InodeCount * sizeof(*path->Inodes), offset);
+        offset += path->InodeCount * sizeof(*path->Inodes);
+        WriteFully(cache, path->Extents, path->ExtentCount * sizeof(*path->Extents), offset);
+        offset += path->ExtentCount * sizeof(*path->Extents);
+    }
+
+    if (ftruncate(cache, offset)) PerrorDie("truncate failed", CACHE_NAME);
+    if (fsync(cache)) PerrorDie("sync failed", CACHE_NAME);
+    close(cache);
+
+    return 0;
+}